@@ -0,0 +1,218 @@
+#include "audio.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+//
+//	Comments explaining the types and functions are
+//	in audio.h, the details are commented here.
+//
+
+//
+//	Looks at a full hop and records an onset if its energy jumps over the
+//	background, then folds the hop into the background level
+//
+static void processHop(AudioOnsetDetector * detector) {
+
+	double energy = 0.0;
+	float peak = 0.0f;
+
+	for (int i = 0; i < AUDIO_HOP_SAMPLES; i++) {
+		energy += (double)detector->hop[i] * detector->hop[i];
+		peak = std::max(peak, std::abs(detector->hop[i]));
+	}
+	energy /= AUDIO_HOP_SAMPLES;
+
+	//
+	//	The first hop is just the level of the background
+	//
+	if (detector->background < 0.0) {
+		detector->background = energy;
+		return;
+	}
+
+	//
+	//	A tiny floor so digital silence doesn't turn every click into a hit
+	//
+	double floor = 1.0;
+
+	if (energy > detector->threshold * (detector->background + floor) &&
+		detector->hop_start_time - detector->last_onset_time >= AUDIO_REFRACTORY_TIME) {
+
+		//
+		//	The onset is the first sample of the hop reaching half of its
+		//	peak, this gives us way better than the hop resolution
+		//
+		int first = 0;
+		while (first < AUDIO_HOP_SAMPLES - 1 && std::abs(detector->hop[first]) < 0.5f * peak) {
+			first++;
+		}
+
+		double onset_time = detector->hop_start_time + (double)first / detector->sample_rate;
+
+		detector->onset_time[detector->next_onset] = onset_time;
+		detector->onset_used[detector->next_onset] = false;
+		detector->next_onset = (detector->next_onset + 1) % AUDIO_MAX_ONSETS;
+		detector->onset_count = std::min(detector->onset_count + 1, AUDIO_MAX_ONSETS);
+		detector->last_onset_time = onset_time;
+	}
+
+	//
+	//	Exponential average of the energy of the hops
+	//
+	double hop_time = (double)AUDIO_HOP_SAMPLES / detector->sample_rate;
+	double alpha = 1.0 - std::exp(-hop_time / AUDIO_BACKGROUND_TIME);
+	detector->background += alpha * (energy - detector->background);
+
+}
+
+void audio_init(AudioOnsetDetector * detector, int sample_rate, float threshold) {
+
+	detector->sample_rate = sample_rate;
+	detector->threshold = threshold;
+
+	detector->hop_fill = 0;
+	detector->hop_start_time = 0.0;
+
+	detector->previous_sample = 0.0f;
+	detector->background = -1.0;
+	detector->last_onset_time = -std::numeric_limits<double>::infinity();
+
+	detector->onset_count = 0;
+	detector->next_onset = 0;
+
+}
+
+void audio_process(
+	AudioOnsetDetector * detector,
+	const int16_t * samples,
+	size_t count,
+	double start_time) {
+
+	if (detector->sample_rate <= 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (detector->hop_fill == 0) {
+			detector->hop_start_time = start_time + (double)i / detector->sample_rate;
+		}
+
+		//
+		//	First difference as the high pass, the hits are all
+		//	high frequencies and the room hum is not
+		//
+		float sample = (float)samples[i];
+		detector->hop[detector->hop_fill++] = sample - detector->previous_sample;
+		detector->previous_sample = sample;
+
+		if (detector->hop_fill == AUDIO_HOP_SAMPLES) {
+			processHop(detector);
+			detector->hop_fill = 0;
+		}
+	}
+
+}
+
+bool audio_takeOnset(
+	AudioOnsetDetector * detector,
+	double time,
+	double window,
+	double * onset_time) {
+
+	int best = -1;
+	double best_distance = window;
+
+	for (int i = 0; i < detector->onset_count; i++) {
+
+		if (detector->onset_used[i]) {
+			continue;
+		}
+
+		double distance = std::abs(detector->onset_time[i] - time);
+		if (distance <= best_distance) {
+			best_distance = distance;
+			best = i;
+		}
+	}
+
+	if (best < 0) {
+		return false;
+	}
+
+	detector->onset_used[best] = true;
+	*onset_time = detector->onset_time[best];
+
+	return true;
+}
+
+bool audio_loadWav(const char * path, std::vector<int16_t> * samples, int * sample_rate) {
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	//
+	//	RIFF header and then chunks, we only care about fmt and data
+	//
+	char riff[12];
+	if (!file.read(riff, 12) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+		return false;
+	}
+
+	int channels = 0;
+	bool found_format = false;
+
+	char chunk_header[8];
+
+	while (file.read(chunk_header, 8)) {
+
+		uint32_t chunk_size =
+			(uint8_t)chunk_header[4] | ((uint8_t)chunk_header[5] << 8) |
+			((uint8_t)chunk_header[6] << 16) | ((uint32_t)(uint8_t)chunk_header[7] << 24);
+
+		if (memcmp(chunk_header, "fmt ", 4) == 0 && chunk_size >= 16) {
+
+			uint8_t format[16];
+			if (!file.read((char *)format, 16)) {
+				return false;
+			}
+
+			int audio_format = format[0] | (format[1] << 8);
+			channels = format[2] | (format[3] << 8);
+			*sample_rate = (int)(format[4] | (format[5] << 8) | (format[6] << 16) | ((uint32_t)format[7] << 24));
+			int bits_per_sample = format[14] | (format[15] << 8);
+
+			found_format = (audio_format == 1 && bits_per_sample == 16 && channels > 0);
+
+			file.seekg(chunk_size - 16 + (chunk_size & 1), std::ios::cur);
+		}
+		else if (memcmp(chunk_header, "data", 4) == 0 && found_format) {
+
+			size_t frame_count = chunk_size / (2 * channels);
+			std::vector<int16_t> interleaved(frame_count * channels);
+			file.read((char *)interleaved.data(), interleaved.size() * 2);
+			frame_count = (size_t)file.gcount() / (2 * channels);
+
+			samples->resize(frame_count);
+			for (size_t i = 0; i < frame_count; i++) {
+				int sum = 0;
+				for (int c = 0; c < channels; c++) {
+					sum += interleaved[i * channels + c];
+				}
+				(*samples)[i] = (int16_t)(sum / channels);
+			}
+
+			return true;
+		}
+		else {
+			file.seekg(chunk_size + (chunk_size & 1), std::ios::cur);
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//
+//	Amount of samples we accumulate the energy of before looking
+//	for an onset, 1.3ms at 48KHz
+//
+#define AUDIO_HOP_SAMPLES 64
+
+//
+//	Amount of onsets waiting to be matched with an impact
+//
+#define AUDIO_MAX_ONSETS 32
+
+//
+//	After an onset we ignore the sound for this long, in seconds,
+//	so the reverberation of a hit doesn't count as another one
+//
+#define AUDIO_REFRACTORY_TIME 0.05
+
+//
+//	Time constant, in seconds, of the background noise level
+//
+#define AUDIO_BACKGROUND_TIME 0.2
+
+//
+//	Finds the sharp sounds (onsets) in a PCM stream: the energy of short
+//	hops of the high passed signal compared with the background level. It
+//	keeps the capture time of the last onsets so they can be matched with
+//	the impacts we see.
+//
+struct AudioOnsetDetector {
+
+	int sample_rate;
+
+	//
+	//	How many times over the background the energy
+	//	of a hop has to be for an onset
+	//
+	float threshold;
+
+	//
+	//	The hop being accumulated, high passed, and the
+	//	capture time of its first sample
+	//
+	float hop[AUDIO_HOP_SAMPLES];
+	int hop_fill;
+	double hop_start_time;
+
+	//
+	//	Last sample for the high pass and the background energy
+	//	level, negative until we have seen the first hop
+	//
+	float previous_sample;
+	double background;
+	double last_onset_time;
+
+	//
+	//	Ring of the last onsets and whether they were already
+	//	matched with an impact
+	//
+	double onset_time[AUDIO_MAX_ONSETS];
+	bool onset_used[AUDIO_MAX_ONSETS];
+	int onset_count;
+	int next_onset;
+
+};
+
+
+//
+//	Inits the detector for a stream with the given sample rate
+//
+void audio_init(AudioOnsetDetector * detector, int sample_rate, float threshold);
+
+
+//
+//	Feeds mono 16 bit samples to the detector, the first one
+//	captured at the given time in seconds
+//
+void audio_process(
+	AudioOnsetDetector * detector,
+	const int16_t * samples,
+	size_t count,
+	double start_time);
+
+
+//
+//	Finds the onset closest to the given time inside the window (in seconds
+//	to every side) that was not matched yet, and marks it as matched.
+//	Returns false if there is none.
+//
+bool audio_takeOnset(
+	AudioOnsetDetector * detector,
+	double time,
+	double window,
+	double * onset_time);
+
+
+//
+//	Loads a PCM 16 bit WAV file, mixing all the channels to mono.
+//	Returns false if it can't be read or has another format.
+//
+bool audio_loadWav(const char * path, std::vector<int16_t> * samples, int * sample_rate);
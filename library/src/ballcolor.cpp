@@ -0,0 +1,186 @@
+#include "ballcolor.h"
+#include <algorithm>
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in ballcolor.h, the details are commented here.
+//
+
+#define BALLCOLOR_BIN_COUNT (BALLCOLOR_HUE_BINS * BALLCOLOR_SATURATION_BINS * BALLCOLOR_VALUE_BINS)
+
+//
+//	Consecutive bins of one channel, the ones of the hue go
+//	around past the last one back to the first
+//
+struct BinRange {
+	int begin;
+	int length;
+};
+
+static bool containsBin(const BinRange & range, int bin, int bin_count) {
+	return (bin - range.begin + bin_count) % bin_count < range.length;
+}
+
+//
+//	The range of one channel with the biggest difference between the ball
+//	and the background in it, given how much of each falls in every bin
+//
+static BinRange fitChannel(const std::vector<double> & ball, const std::vector<double> & background, bool wraps) {
+
+	int bin_count = (int)ball.size();
+	BinRange best_range = { 0, bin_count };
+	double best_score = -INFINITY;
+
+	for (int begin = 0; begin < bin_count; begin++) {
+
+		double ball_sum = 0.0;
+		double background_sum = 0.0;
+		int max_length = (wraps ? bin_count : bin_count - begin);
+
+		for (int length = 1; length <= max_length; length++) {
+
+			int bin = (begin + length - 1) % bin_count;
+			ball_sum += ball[bin];
+			background_sum += background[bin];
+
+			double score = ball_sum - background_sum - BALLCOLOR_WIDTH_PENALTY * length / bin_count;
+			if (score > best_score) {
+				best_score = score;
+				best_range = { begin, length };
+			}
+		}
+	}
+
+	return best_range;
+}
+
+void ballcolor_reset(ColorHistogram * histogram) {
+	histogram->bins.assign(BALLCOLOR_BIN_COUNT, 0);
+	histogram->total = 0;
+}
+
+void ballcolor_add(ColorHistogram * histogram, const cv::Mat & hsv, const cv::Mat & mask) {
+
+	if (histogram->bins.size() != BALLCOLOR_BIN_COUNT) {
+		ballcolor_reset(histogram);
+	}
+
+	for (int y = 0; y < hsv.rows; y++) {
+
+		const cv::Vec3b * hsv_row = hsv.ptr<cv::Vec3b>(y);
+		const uchar * mask_row = mask.ptr<uchar>(y);
+
+		for (int x = 0; x < hsv.cols; x++) {
+
+			if (!mask_row[x]) {
+				continue;
+			}
+
+			int h = std::min(hsv_row[x][0] * BALLCOLOR_HUE_BINS / 180, BALLCOLOR_HUE_BINS - 1);
+			int s = hsv_row[x][1] * BALLCOLOR_SATURATION_BINS / 256;
+			int v = hsv_row[x][2] * BALLCOLOR_VALUE_BINS / 256;
+
+			histogram->bins[(h * BALLCOLOR_SATURATION_BINS + s) * BALLCOLOR_VALUE_BINS + v]++;
+			histogram->total++;
+		}
+	}
+}
+
+bool ballcolor_fit(const ColorHistogram * ball, const ColorHistogram * background, BallColorFit * fit) {
+
+	if (ball->total < BALLCOLOR_MIN_PIXELS || background->total == 0 ||
+		ball->bins.size() != BALLCOLOR_BIN_COUNT || background->bins.size() != BALLCOLOR_BIN_COUNT) {
+		return false;
+	}
+
+	const int bin_counts[3] = { BALLCOLOR_HUE_BINS, BALLCOLOR_SATURATION_BINS, BALLCOLOR_VALUE_BINS };
+	BinRange ranges[3] = {
+		{ 0, BALLCOLOR_HUE_BINS },
+		{ 0, BALLCOLOR_SATURATION_BINS },
+		{ 0, BALLCOLOR_VALUE_BINS } };
+
+	double ball_coverage = 0.0;
+	double background_coverage = 0.0;
+
+	//
+	//	Best box of the joint histogram one channel at a time: every channel
+	//	gets the range that sets the ball apart the most among the pixels
+	//	inside the ranges of the other two, and again with the new ranges
+	//
+	for (int round = 0; round <= BALLCOLOR_FIT_ROUNDS; round++) {
+
+		for (int axis = 0; axis < 3; axis++) {
+
+			std::vector<double> ball_profile(bin_counts[axis], 0.0);
+			std::vector<double> background_profile(bin_counts[axis], 0.0);
+			ball_coverage = 0.0;
+			background_coverage = 0.0;
+
+			for (int h = 0; h < BALLCOLOR_HUE_BINS; h++) {
+				for (int s = 0; s < BALLCOLOR_SATURATION_BINS; s++) {
+					for (int v = 0; v < BALLCOLOR_VALUE_BINS; v++) {
+
+						const int bin[3] = { h, s, v };
+						bool inside = true;
+						for (int other = 0; other < 3 && inside; other++) {
+							inside = (other == axis || containsBin(ranges[other], bin[other], bin_counts[other]));
+						}
+						if (!inside) {
+							continue;
+						}
+
+						int index = (h * BALLCOLOR_SATURATION_BINS + s) * BALLCOLOR_VALUE_BINS + v;
+						double ball_fraction = (double)ball->bins[index] / ball->total;
+						double background_fraction = (double)background->bins[index] / background->total;
+
+						ball_profile[bin[axis]] += ball_fraction;
+						background_profile[bin[axis]] += background_fraction;
+
+						if (containsBin(ranges[axis], bin[axis], bin_counts[axis])) {
+							ball_coverage += ball_fraction;
+							background_coverage += background_fraction;
+						}
+					}
+				}
+			}
+
+			//
+			//	The last round only measures the ranges we ended up with
+			//
+			if (round < BALLCOLOR_FIT_ROUNDS) {
+				ranges[axis] = fitChannel(ball_profile, background_profile, axis == 0);
+			}
+		}
+	}
+
+	if (ball_coverage <= background_coverage) {
+		return false;
+	}
+
+	//
+	//	From bins to the values of the channels, the whole
+	//	hue circle is a normal range from 0 to 179
+	//
+	if (ranges[0].length >= BALLCOLOR_HUE_BINS) {
+		fit->h_low = 0;
+		fit->h_high = 179;
+	}
+	else {
+		fit->h_low = ranges[0].begin * 180 / BALLCOLOR_HUE_BINS;
+		fit->h_high = ((ranges[0].begin + ranges[0].length) % BALLCOLOR_HUE_BINS) * 180 / BALLCOLOR_HUE_BINS - 1;
+		if (fit->h_high < 0) {
+			fit->h_high = 179;
+		}
+	}
+
+	fit->s_low = ranges[1].begin * 256 / BALLCOLOR_SATURATION_BINS;
+	fit->s_high = (ranges[1].begin + ranges[1].length) * 256 / BALLCOLOR_SATURATION_BINS - 1;
+	fit->v_low = ranges[2].begin * 256 / BALLCOLOR_VALUE_BINS;
+	fit->v_high = (ranges[2].begin + ranges[2].length) * 256 / BALLCOLOR_VALUE_BINS - 1;
+
+	fit->ball_coverage = (float)ball_coverage;
+	fit->background_coverage = (float)background_coverage;
+
+	return true;
+}
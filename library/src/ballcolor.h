@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+//
+//	Bins of the histogram along every channel, 4 hues (of the 180
+//	of OpenCV) and 8 levels of saturation and value per bin
+//
+#define BALLCOLOR_HUE_BINS 45
+#define BALLCOLOR_SATURATION_BINS 32
+#define BALLCOLOR_VALUE_BINS 32
+
+//
+//	Fewest pixels of the ball we need to trust the histogram
+//
+#define BALLCOLOR_MIN_PIXELS 200
+
+//
+//	Cost of a range as wide as the whole channel, in fraction of the
+//	pixels of the ball, so bins with barely any ball in them and no
+//	background are left out and the ranges stay tight
+//
+#define BALLCOLOR_WIDTH_PENALTY 0.05f
+
+//
+//	Times we go over the three channels fitting one with the other two fixed
+//
+#define BALLCOLOR_FIT_ROUNDS 3
+
+//
+//	Joint histogram of the hue, saturation and value of some pixels
+//
+struct ColorHistogram {
+	std::vector<uint32_t> bins;
+	uint64_t total;
+};
+
+//
+//	Colour ranges of the ball in HSV as OpenCV keeps it. The hue wraps
+//	around (reds) when h_low is bigger than h_high. The coverages are the
+//	fractions of the pixels of the ball and of the background in the ranges.
+//
+struct BallColorFit {
+	int h_low;
+	int h_high;
+	int s_low;
+	int s_high;
+	int v_low;
+	int v_high;
+	float ball_coverage;
+	float background_coverage;
+};
+
+
+//
+//	Empties the histogram
+//
+void ballcolor_reset(ColorHistogram * histogram);
+
+
+//
+//	Adds the pixels of an HSV image that are set in the mask
+//
+void ballcolor_add(ColorHistogram * histogram, const cv::Mat & hsv, const cv::Mat & mask);
+
+
+//
+//	Fits the ranges that take the most of the ball and the least of the
+//	background (the biggest difference between both coverages). Returns
+//	false if there are not enough pixels of the ball or nothing sets it
+//	apart from the background.
+//
+bool ballcolor_fit(const ColorHistogram * ball, const ColorHistogram * background, BallColorFit * fit);
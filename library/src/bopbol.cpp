@@ -2,11 +2,27 @@
 #include "utils.h"
 #include "types.h"
 #include "error.h"
+#include "audio.h"
+#include "ballcolor.h"
+#include "coordinator.h"
+#include "corners.h"
+#include "geometry.h"
+#include "patterns.h"
+#include "pipeline.h"
+#include "shadow.h"
+#include "stereo.h"
+#include "threadpool.h"
+#include "tracker.h"
+#include "trackpool.h"
+#include "trajectory.h"
+#include "zones.h"
 #include <thread>
 #include <chrono>
 #include <opencv2/opencv.hpp>
 #include <opencv2/tracking.hpp>
+#include <memory>
 #include <mutex>
+#include <limits>
 
 
 //
@@ -15,18 +31,55 @@
 //  ============================================
 //
 
-#define DEQUE_SIZE_FOR_COLLISION 3
-#define COLLISION_PAST_STEPS 1
+#define MEASUREMENTS_FOR_COLLISION 3
 #define NUM_FRAMES_SHOW_COLLISION 20
-#define NUM_FRAMES_LOST_BALL 7
 #define CALIBRATION_WARMUP 20
 
-#define CIRCLE_CONTOUR_LIMIT 3
-#define EPSILON_MULTIPLIER 6
-#define EPSILON_DIV (float)1000.0f
+//
+//	Frames we drop after the projector changes the calibration pattern,
+//	the ones the camera had already captured with the previous one
+//
+#define PATTERN_SETTLE_FRAMES 5
+
+//
+//	Views of the chessboard we need to calibrate the lens
+//
+#define INTRINSICS_MIN_VIEWS 5
+
+//
+//	Frames the background model of the automatic ball calibration
+//	remembers, and the morphology cleaning its foreground mask
+//
+#define BALL_CALIBRATION_HISTORY 100
+#define BALL_CALIBRATION_MORPHOLOGY_ITERATIONS 2
 
 #define RADIUS_LATERAL_MULT 0.66f
 
+//
+//	Percentage of the circle enclosing a blob its pixels have to fill to
+//	be a ball. A streak of a fast ball fills about 40%, lines and slivers
+//	of the background much less.
+//
+#define MIN_FILL_PERCENT 20
+
+//
+//	Weight of every new impact in the running
+//	estimate of the radius of the ball at the wall
+//
+#define IMPACT_RADIUS_SMOOTHING 0.25f
+
+//
+//	Confidence of an impact we didn't see is this
+//	to the power of the amount of frames we missed
+//
+#define OCCLUDED_IMPACT_CONFIDENCE_DECAY 0.8f
+
+//
+//	Cache budget for every strip of the frame pipeline,
+//	a conservative L2 size for the kiosk CPUs
+//
+#define STRIP_CACHE_BYTES (256 * 1024)
+
 //
 //  ============================================
 //             INTERNAL STRUCTURES
@@ -79,20 +132,109 @@ struct ConfigurationParameters {
 struct CallbackFunctionPointers {
 	BbCoordinateCallback coordinate_callback = NULL;
 	BbErrorCallback error_callback = NULL;
+	BbImpactCallback impact_callback = NULL;
+	BbAreaCalibrationCallback area_calibration_callback = NULL;
+};
+
+struct ProjectionArea {
+
+	uint32_t area_id = 0;
+
+	//
+	//	Corners of the area as seen in the frames and the homography
+	//	that maps the frames, without the distortion of the lens, to it
+	//
+	std::vector<cv::Point2f> area_points;
+	cv::Mat homography_matrix;
+
+	//
+	//	Where the normal of its wall vanishes, the walls of the
+	//	areas don't have to be parallel
+	//
+	cv::Vec3d wall_vanishing_point;
 };
 
 struct CalibrationState {
-	std::vector<std::vector<cv::Point2f>> square_points;
+
+	//
+	//	Running statistics of the corners found while calibrating
+	//	and when to leave them out or finish
+	//
+	CornerEstimator corners;
+	BbAreaCalibrationParameters parameters;
+
+	//
+	//	How well the corners found fit the detections
+	//
+	float reprojection_error = 0.0f;
+	float inlier_ratio = 0.0f;
+
+	//
+	//	Corners of the area as seen in the frames and without the
+	//	distortion of the lens, the homography maps the latter
+	//
+	std::vector<cv::Point2f> area_points;
 	std::vector<cv::Point2f> average_points;
 
 	cv::Mat homography_matrix;
 
 	bool have_matrix = false;
+
+	//
+	//	Whether the area calibration going on showed any window
+	//
+	bool shown_windows = false;
+
+	//
+	//	Lens of the camera and the chessboard corners of
+	//	the views taken while calibrating it
+	//
+	BbCameraIntrinsics camera_intrinsics;
+	std::vector<std::vector<cv::Point2f>> intrinsics_image_points;
+	std::vector<std::vector<cv::Point3f>> intrinsics_object_points;
+	cv::Size intrinsics_image_size;
+
+	//
+	//	The other areas seen by the camera, the impacts
+	//	outside of the main one are routed to them
+	//
+	std::vector<ProjectionArea> projection_areas;
+
+	//
+	//	Frames of the patterns shown by the projector
+	//	when calibrating the area with them
+	//
+	PatternDecoder patterns;
 };
 
 struct ContourParameters {
-	int circle_contour_limit = CIRCLE_CONTOUR_LIMIT;
-	int epsilon_multiplier = EPSILON_MULTIPLIER;
+	int min_fill_percent = MIN_FILL_PERCENT;
+};
+
+struct StereoState {
+
+	//
+	//	Index of the second camera, -1 when we only use one
+	//
+	int camera_index = -1;
+	cv::VideoCapture *video = NULL;
+
+	//
+	//	Its own executor for the detection and the blobs of the last frame
+	//
+	FramePipeline pipeline;
+	std::vector<Blob> blobs;
+
+	//
+	//	The area as the second camera sees it, there is no lens
+	//	correction for it so they are the same points
+	//
+	CornerEstimator corners;
+	std::vector<cv::Point2f> area_points;
+	cv::Mat homography_matrix;
+	bool have_matrix = false;
+
+	PatternDecoder patterns;
 };
 
 struct BbInstance_T {
@@ -101,6 +243,7 @@ struct BbInstance_T {
 	ConfigurationParameters s_configuration_parameters;
 	CallbackFunctionPointers s_callback_functions;
 	CalibrationState s_calibration_state;
+	StereoState s_stereo;
 	ContourParameters s_contour_parameters;
 
 	//
@@ -113,21 +256,78 @@ struct BbInstance_T {
 	std::mutex s_configuration_mutex;
 
 
+	//
+	//	Strip based executor for the per pixel stages of the
+	//	detection and the blobs it found in the last frame.
+	//
+	FramePipeline s_frame_pipeline;
+	std::vector<Blob> s_frame_blobs;
+
+	//
+	//	Pool sized to the machine where the tiles of the
+	//	frame pipeline get processed in parallel.
+	//
+	ThreadPool s_thread_pool;
+
+	//
+	//	Scratch buffers to look for the shadows of the balls
+	//
+	ShadowDetector s_shadow_detector;
+
+	//
+	//	Hit zones of the host, replaced at once by swapping the pointer
+	//	so the processing never waits for them (always use atomic_load
+	//	and atomic_store with it)
+	//
+	std::shared_ptr<const ZoneIndex> s_zone_index;
+
+	//
+	//	Where the normal of the calibrated wall vanishes in the frame, in
+	//	homogeneous coordinates, while detecting reversals along it
+	//
+	cv::Vec3d s_wall_vanishing_point;
+	bool s_have_wall_normal = false;
+
+	//
+	//	Every ball we are following, with its motion model and the
+	//	last BALL_HISTORY_LENGTH positions, radii and capture times
+	//
+	TrackPool s_track_pool;
+
+	//
+	//	Apparent radius of the ball on the last impacts (smoothed), it tells
+	//	us how deep the wall is. It is 0 until we see the first impact.
+	//
+	float s_impact_radius = 0.0f;
+
+	//
+	//	Amount of impacts reported to give them ids
+	//
+	uint32_t s_impact_count = 0;
 
 	//
-	//	Stores the last N positions of the ball.
+	//	Parameters of the motion model of the balls
 	//
-	Deque s_main_deque;
+	BbTrackingParameters s_tracking_parameters;
 
 	//
-	//	The amount of frames that we have not seen the ball
+	//	Sounds of the hits, pushed from a microphone or read from the
+	//	WAV file along with the frames. They have their own mutex so
+	//	pushing samples doesn't wait for a whole frame to be processed.
 	//
-	int s_lost_ball_for_frames = 0;
+	std::mutex s_audio_mutex;
+	AudioOnsetDetector s_audio_detector;
+	BbAudioParameters s_audio_parameters;
+	std::vector<int16_t> s_audio_file_samples;
+	size_t s_audio_file_position = 0;
 
 	//
-	//	Wether or not we had a ball in the previous frame
+	//	Capture clock, timestamps are seconds since the processing
+	//	was launched (or the position in the video file). It is set
+	//	under s_audio_mutex, bbPushAudioSamples reads it from the host.
 	//
-	bool s_had_ball_previous_frame = false;
+	std::chrono::steady_clock::time_point s_launch_time;
+	unsigned int s_frame_id = 0;
 
 	//
 	//	Stores the coordinates in screen space in which
@@ -146,6 +346,14 @@ struct BbInstance_T {
 	//	a premade one or a real time source.
 	//
 	cv::VideoCapture *s_video = NULL;
+	int s_camera_index = 0;
+
+	//
+	//	The coordinator this instance is a camera of, which gets its
+	//	impacts instead of the callbacks, and its index in it
+	//
+	BbCoordinator_T *s_coordinator = NULL;
+	int s_coordinator_camera = -1;
 
 	//
 	//	When true, stops the video processing by ending the
@@ -164,6 +372,23 @@ struct BbInstance_T {
 	//	Calibration parameters
 	//
 	bool s_is_calibrating_projection = false;
+	bool s_is_calibrating_intrinsics = false;
+
+};
+
+struct BbCoordinator_T {
+
+	//
+	//	Protects everything here, the cameras report from their
+	//	own threads so the callback is called with it locked
+	//
+	std::mutex s_mutex;
+
+	ImpactCoordinator s_coordinator;
+	std::vector<BbInstance_T*> s_cameras;
+	BbImpactCallback s_impact_callback = NULL;
+
+	bool s_running = false;
 
 };
 
@@ -174,6 +399,24 @@ struct BbInstance_T {
 //  ============================================
 //
 
+/**
+Processes the frames of the instance until it is told to stop, with the
+timestamps relative to the given launch time
+
+@param The instance of the library to run, already marked as running
+@param The time the timestamps count from
+@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+*/
+BbResult runInstance(BbInstance_T* instance, std::chrono::steady_clock::time_point launch_time);
+
+/**
+Tells the coordinator of the instance where its balls seen in this frame are
+
+@param The instance of the library that is a camera of a coordinator
+@param The capture time of the frame
+*/
+void publishTracks(BbInstance_T* instance, double timestamp);
+
 /**
 Reads the position of the mouse and returns it in the struct
 
@@ -202,6 +445,363 @@ Parses one frame of the image retrieved by the webcam.
 */
 BbResult parseFrame(BbInstance_T* instance);
 
+/**
+Fits the trajectory of the ball before and after the direction change we
+just detected and finds the time and position where they meet.
+
+@param The instance of the library to use
+@param The slot of the ball in the track pool
+@param Unit vector pointing towards the wall, along which the ball turned around
+@param The position of the ball in the current frame
+@param The capture time of the current frame
+@param Output time of the impact
+@param Output position of the impact in frame coordinates
+@param Output amount of elements of the history that were already after the impact
+@return true if the trajectories meet between the frames, false to fall back to the frame times
+*/
+bool estimateImpact(
+	BbInstance_T* instance,
+	int slot,
+	cv::Point2f direction,
+	cv::Point2f position,
+	double timestamp,
+	double* impact_time,
+	cv::Point2f* impact_position,
+	unsigned int* samples_after_impact);
+
+/**
+Looks for balls we lost while going to the wall among the blobs no ball
+claimed, considering that they bounced while we couldn't see them. The
+matched balls get the blob assigned with the impact we inferred.
+
+@param The instance of the library to use
+@param The indices of the candidate blobs
+@param The amount of candidate blobs
+@param Which candidates have already been claimed, updated here
+@param The capture time of the current frame
+@param The amount of rows of the current frame
+*/
+void matchOccludedBounces(
+	BbInstance_T* instance,
+	const int* candidates,
+	int candidate_count,
+	bool* candidate_used,
+	double timestamp,
+	int frame_rows);
+
+/**
+Looks for the shadow of every ball we see inside the area and keeps how
+far it is from the ball, and if it is getting closer.
+
+@param The instance of the library to use
+@param The frame, before we draw anything on it
+*/
+void measureShadows(BbInstance_T* instance, const cv::Mat& frame);
+
+/**
+Tells if a point of the frame is inside the calibrated area
+
+@param The instance of the library to use
+@param The point in frame coordinates
+@return true if the area is calibrated and the point is inside
+*/
+bool isInsideArea(BbInstance_T* instance, cv::Point2f point);
+
+/**
+Fits the depth of the ball since its last impact and checks what the
+new radius measurement says about it.
+
+@param The instance of the library to use
+@param The slot of the ball in the track pool
+@param The radius of the ball in the current frame
+@param The capture time of the current frame
+@param Output depth segment of the ball before this frame
+@return The trend of the depth with the new measurement, see DepthTrend
+*/
+DepthTrend checkDepthTrend(
+	BbInstance_T* instance,
+	int slot,
+	float radius,
+	double timestamp,
+	DepthSegment* incoming);
+
+/**
+Finds the time of a bounce we detected in depth and where the ball was then.
+
+@param The instance of the library to use
+@param The slot of the ball in the track pool
+@param The depth segment of the ball before the bounce
+@param The radius of the ball in the current frame
+@param The capture time of the current frame
+@param Output time of the impact
+@param Output position of the impact in frame coordinates
+@return true if the depths meet between the frames, false to fall back to the frame times
+*/
+bool estimateDepthImpact(
+	BbInstance_T* instance,
+	int slot,
+	const DepthSegment* incoming,
+	float radius,
+	double timestamp,
+	double* impact_time,
+	cv::Point2f* impact_position);
+
+/**
+Looks at the depth and the motion of the ball to tell if it will hit the
+area soon and reports a predicted impact if we are confident enough.
+
+@param The instance of the library to use
+@param The slot of the ball in the track pool
+@param The capture time of the current frame
+*/
+void predictImpact(BbInstance_T* instance, int slot, double timestamp);
+
+/**
+Tells the host the predicted impact of a ball won't be confirmed, if
+there is one waiting, because the ball was lost or didn't bounce in time.
+
+@param The instance of the library to use
+@param The slot of the ball in the track pool
+*/
+void cancelPredictedImpact(BbInstance_T* instance, int slot);
+
+/**
+Updates one of the balls we follow with the blob assigned to it in this
+frame (if any), detecting its collisions and drawing it.
+
+@param The instance of the library to use
+@param The slot of the ball in the track pool
+@param The blob assigned to the ball, NULL if we didn't see it
+@param The capture time of the current frame
+@param The frame to draw on
+*/
+void updateTrack(BbInstance_T* instance, int slot, const Blob* blob, double timestamp, cv::Mat& frame);
+
+/**
+Measures for every ball we see how much the second camera disagrees about
+where it is in the area, if there is a second camera and both are calibrated
+
+@param The instance of the library to use
+*/
+void measureStereo(BbInstance_T* instance);
+
+/**
+Finds the biggest quadrilateral in a mask of the colour of the area
+
+@param The mask of the colour of the area
+@param Output corners of the quadrilateral, sorted
+@return true if there is one
+*/
+bool findAreaCorners(const cv::Mat& mask, std::vector<cv::Point2f>* corners);
+
+/**
+Looks for the area in a frame of the second camera (if any) with the given
+colour range and keeps its corners for the calibration
+
+@param The instance of the library to calibrate
+@param The lower range of the colour of the area in HSV
+@param The upper range of the colour of the area in HSV
+@param Whether to show the mask, if the configuration outputs the frames
+*/
+void calibrateStereoArea(BbInstance_T* instance, const cv::Scalar& hsv_low, const cv::Scalar& hsv_high, bool show_frames);
+
+/**
+Gets the frame to calibrate with, without showing anything: a copy of the
+one the host sends or, if it doesn't, one read from the camera once it settles
+
+@param The instance of the library being calibrated, with the configuration locked
+@param The frame sent by the host, NULL to read it from the camera
+@param Frames read from the camera to get the last one
+@param Output frame in BGR
+@return true if we have the frame
+*/
+bool getCalibrationFrame(BbInstance_T* instance, const BbFrame* host_frame, int settle_frames, cv::Mat* frame);
+
+/**
+Opens the camera for a calibration if it isn't open yet
+
+@param The instance of the library being calibrated, with the configuration locked
+@return true if the camera is open
+*/
+bool openCalibrationCamera(BbInstance_T* instance);
+
+/**
+The colour of one pixel of a frame in HSV, like the click calibrations take it
+
+@param The frame in BGR
+@param The pixel in coordinates of the frame
+@param Output colour in HSV
+@return false if the pixel is out of the frame
+*/
+bool sampleHSV(const cv::Mat& frame, cv::Point point, cv::Vec3b* hsv);
+
+/**
+Looks for the area in a frame with the given colour range and adds its corners
+to the calibration, without showing anything
+
+@param The instance of the library being calibrated, with the configuration locked
+@param The frame in BGR, at the resolution of the camera
+@param The lower range of the colour of the area in HSV
+@param The upper range of the colour of the area in HSV
+@return true if the area was found in the frame
+*/
+bool calibrateAreaFrame(BbInstance_T* instance, cv::Mat frame, const cv::Scalar& hsv_low, const cv::Scalar& hsv_high);
+
+/**
+Sets the colour ranges of the ball from its colour where it is dark and where
+it is lit, widened by the thresholds
+
+@param The instance of the library being calibrated, with the configuration locked
+@param The colour of the dark side of the ball in HSV
+@param The colour of the lit side of the ball in HSV
+@param threshold value for the hue of the ball
+@param threshold value for the saturation of the ball
+@param threshold value for the value of the ball
+*/
+void setBallRanges(
+	BbInstance_T* instance,
+	cv::Vec3b hsv_dark,
+	cv::Vec3b hsv_lit,
+	int hue_threshold,
+	int saturation_threshold,
+	int value_threshold);
+
+/**
+The corners of the area in normalized coordinates, in the order
+of the sorted corners of the calibration
+
+@return The four corners
+*/
+std::vector<cv::Point2f> getNormalizedAreaCorners();
+
+/**
+Ends the area calibration with the mean of the corners found, for the second
+camera too if there is one, and releases the cameras. After the calibration
+has already finished it returns the corners of the area again.
+
+@param The instance of the library being calibrated, with the configuration locked
+@return The corners of the area, not valid if we couldn't find them
+*/
+BbAreaCalibration finishAreaCalibration(BbInstance_T* instance);
+
+/**
+Ends the area calibration if the corners stopped moving, and tells the host
+
+@param The instance of the library being calibrated, with the configuration locked
+*/
+void checkAreaCalibration(BbInstance_T* instance);
+
+/**
+Corrects the corners of the area for the distortion of the lens and
+calculates the homography that maps the frame to the area with them
+
+@param The instance of the library to use
+*/
+void updateHomography(BbInstance_T* instance);
+
+/**
+Maps a position in the frame to the normalized coordinates of the area,
+correcting it for the distortion of the lens first
+
+@param The instance of the library to use, it must have the homography
+@param The position in frame coordinates
+@return The position in area coordinates, from 0 to 1 inside of it
+*/
+cv::Point2f mapToArea(BbInstance_T* instance, cv::Point2f frame_position);
+
+/**
+Maps a position of the frame with the homography of any area
+
+@param The instance of the library to use
+@param The homography of the area
+@param The position in frame coordinates
+@return The position in area coordinates, from 0 to 1 inside of it
+*/
+cv::Point2f mapWithHomography(BbInstance_T* instance, const cv::Mat& homography, cv::Point2f frame_position);
+
+/**
+Finds the area a position of the frame is in, the main one first and
+then the others in order. Positions out of all of them are in the main one.
+
+@param The instance of the library to use
+@param The position in frame coordinates
+@param Output position in coordinates of the area found
+@return The index of the area in the projection areas, or -1 for the main one
+*/
+int routeToArea(BbInstance_T* instance, cv::Point2f frame_position, cv::Point2f* area_position);
+
+/**
+Replaces the other projection areas of the instance, the ones with
+invalid corners and the ones over BB_MAX_PROJECTION_AREAS are left out
+
+@param The instance of the library to use
+@param The areas given by the host
+@param The amount of areas
+*/
+void setProjectionAreas(BbInstance_T* instance, const BbProjectionArea* areas, uint32_t area_count);
+
+/**
+Computes the homography of one of the other projection areas from its corners
+
+@param The instance of the library with the lens of the camera
+@param The area to update
+*/
+void updateAreaHomography(BbInstance_T* instance, ProjectionArea* area);
+
+/**
+Direction in the frame along which we look for the ball turning around, the
+x axis or, if we detect the reversals along the normal of the wall, where a
+ball at the given position moves when it goes straight towards the wall
+
+@param The instance of the library to use
+@param The position of the ball in the current frame
+@return Unit direction in frame coordinates, getWallSide tells its sign
+*/
+cv::Point2f getWallAxis(BbInstance_T* instance, cv::Point2f position);
+
+/**
+Side of the wall along the axis given by getWallAxis, from the calibration.
+With the normal of the wall the axis points to its vanishing point, where a
+ball moving away from the camera goes, otherwise the wall is towards the
+middle of the area the ball is in front of.
+
+@param The instance of the library to use
+@param The position of the ball in the current frame
+@param The axis of the wall at that position
+@return 1 if the wall is along the axis, -1 if against it, 0 if we can't tell
+*/
+int getWallSide(BbInstance_T* instance, cv::Point2f position, cv::Point2f wall_axis);
+
+/**
+Feeds the samples of the audio file (if any) up to the given time to the
+onset detector, so the sounds of the impacts of this frame can be found
+
+@param The instance reading the audio file
+@param The capture time, in seconds, of the frame being processed
+*/
+void readAudioFile(BbInstance_T* instance, double timestamp);
+
+/**
+Replaces the timestamp of a confirmed impact with the time of the sound of
+the hit, if we heard one close enough to it
+
+@param The instance that detected the impact
+@param The impact to refine
+*/
+void matchImpactSound(BbInstance_T* instance, BbImpactEvent* event);
+
+/**
+Maps the position of an impact in frame coordinates to the calibrated area,
+fills the coordinates of the event and calls the callbacks of the host.
+Predicted impacts falling outside of the area are not reported.
+
+@param The instance of the library to use
+@param The event to report, the coordinates get filled here
+@param The position of the impact in frame coordinates
+@return true if the impact was reported
+*/
+bool reportImpact(BbInstance_T* instance, BbImpactEvent* event, cv::Point2f frame_position);
+
 /**
 Prints the usage of this program in the command line
 */
@@ -223,6 +823,16 @@ inline BbInstance_T* castInstance(BbInstance instance) {
 	return reinterpret_cast<BbInstance_T*>(instance);
 }
 
+/**
+Parses the coordinator handle to our real internal pointer type
+
+@param The external coordinator handle
+@return The internal coordinator type
+*/
+inline BbCoordinator_T* castCoordinator(BbCoordinator coordinator) {
+	return reinterpret_cast<BbCoordinator_T*>(coordinator);
+}
+
 //
 //  ============================================
 //           DEFINING EXTERNAL FUNCTIONS
@@ -243,16 +853,17 @@ BbResult bbInit(BbInstance a_instance) {
 
 
 	//
-	//	This is our circular queue that will store the
-	//	last DEQUE_LENGTH positions of the ball in the frame 
+	//	This is our pool of balls, every one with a ring buffer that
+	//	will store its last BALL_HISTORY_LENGTH positions in the frame
 	//
-	deque_init(&instance->s_main_deque);
+	trackpool_init(&instance->s_track_pool);
+	instance->s_impact_radius = 0.0f;
 
 	//
 	//	Simply opening the video source for the webcam since
 	//	we are always calling from Unity
 	//
-	instance->s_video->open(0);
+	instance->s_video->open(instance->s_camera_index);
 
 
 
@@ -281,15 +892,38 @@ BbResult bbLaunch(BbInstance a_instance) {
 	BbInstance_T* instance = castInstance(a_instance);
 	if (instance == nullptr) return BB_FAILURE;
 
-	//
-	//	Inside this function we are opening and releasing
-	//	the video source to avoid accessing the webcam constantly.
-	//
-	instance->s_video->open(0);
-
 	instance->s_should_stop = false;
 	instance->s_running = true;
 
+	return runInstance(instance, std::chrono::steady_clock::now());
+}
+
+BbResult runInstance(BbInstance_T* instance, std::chrono::steady_clock::time_point launch_time) {
+
+	//
+	//	Inside this function we are opening and releasing
+	//	the video source to avoid accessing the webcam constantly.
+	//
+	instance->s_video->open(instance->s_camera_index);
+	if (instance->s_stereo.camera_index >= 0) {
+		instance->s_stereo.video->open(instance->s_stereo.camera_index);
+	}
+
+	trackpool_init(&instance->s_track_pool);
+
+	//
+	//	The sounds are matched against this launch's clock, the old
+	//	onsets are meaningless now and the file starts over. The clock
+	//	is set under the lock since the microphone reads it too.
+	//
+	instance->s_audio_mutex.lock();
+	instance->s_launch_time = launch_time;
+	audio_init(&instance->s_audio_detector,
+		instance->s_audio_detector.sample_rate,
+		instance->s_audio_parameters.onset_threshold);
+	instance->s_audio_file_position = 0;
+	instance->s_audio_mutex.unlock();
+
 	//
 	//	We destroy the previous windows that might me mangling
 	//	arround.
@@ -314,8 +948,7 @@ BbResult bbLaunch(BbInstance a_instance) {
 		cvCreateTrackbar("LowV", "Control", &instance->s_ball_detection_parameters.v_low, 255); //Value (0 - 255)
 		cvCreateTrackbar("HighV", "Control", &instance->s_ball_detection_parameters.v_high, 255);
 		cvCreateTrackbar("Radius", "Control", &instance->s_ball_detection_parameters.radius_threshold, 100);
-		cvCreateTrackbar("Contour Limit", "Control", &instance->s_contour_parameters.circle_contour_limit, 20);
-		cvCreateTrackbar("Epsilon Multiplier", "Control", &instance->s_contour_parameters.epsilon_multiplier, 200);
+		cvCreateTrackbar("Min Fill %", "Control", &instance->s_contour_parameters.min_fill_percent, 100);
 		cvCreateTrackbar("Collision", "Control", &instance->s_configuration_parameters.show_collisions, 1);
 	}
 
@@ -338,6 +971,7 @@ BbResult bbLaunch(BbInstance a_instance) {
 	cv::destroyAllWindows();
 
 	instance->s_video->release();
+	instance->s_stereo.video->release();
 
 	instance->s_running = false;
 
@@ -369,6 +1003,16 @@ BbInstance bbCreateInstance() {
 	}
 
 	instance->s_video = new cv::VideoCapture();
+	instance->s_stereo.video = new cv::VideoCapture();
+
+	threadpool_init(&instance->s_thread_pool, 0);
+
+	pipeline_init(&instance->s_frame_pipeline, STRIP_CACHE_BYTES, threadpool_getThreadCount(&instance->s_thread_pool));
+	pipeline_init(&instance->s_stereo.pipeline, STRIP_CACHE_BYTES, threadpool_getThreadCount(&instance->s_thread_pool));
+
+	trackpool_init(&instance->s_track_pool);
+
+	audio_init(&instance->s_audio_detector, 0, instance->s_audio_parameters.onset_threshold);
 
 	return instance;
 }
@@ -377,7 +1021,10 @@ void bbDestroyInstance(BbInstance a_instance) {
 	BbInstance_T* instance = castInstance(a_instance);
 	if (instance == nullptr) return;
 
+	threadpool_destroy(&instance->s_thread_pool);
+
 	delete instance->s_video;
+	delete instance->s_stereo.video;
 	delete instance;
 }
 
@@ -443,172 +1090,330 @@ BbResult bbSetConfigurationParameters(
 	return BB_SUCCESS;
 }
 
-BbResult bbSetCoordinateCallback(
+BbResult bbSetStereoCamera(
 	BbInstance a_instance,
-	BbCoordinateCallback callback_function_ptr) {
+	int camera_index) {
 
 	BbInstance_T* instance = castInstance(a_instance);
 	if (instance == nullptr) return BB_FAILURE;
 
 	instance->s_configuration_mutex.lock();
 
-	instance->s_callback_functions.coordinate_callback = callback_function_ptr;
+	//
+	//	Another camera means another calibration
+	//
+	if (camera_index != instance->s_stereo.camera_index) {
+		instance->s_stereo.have_matrix = false;
+		instance->s_stereo.area_points.clear();
+		instance->s_stereo.homography_matrix = cv::Mat();
+	}
+
+	instance->s_stereo.camera_index = (camera_index >= 0 ? camera_index : -1);
 
 	instance->s_configuration_mutex.unlock();
 
 	return BB_SUCCESS;
 }
 
-BbResult bbSetErrorCallback(
+BbResult bbSetTrackingParameters(
 	BbInstance a_instance,
-	BbErrorCallback callback_function_ptr) {
+	BbTrackingParameters tracking_parameters) {
 
 	BbInstance_T* instance = castInstance(a_instance);
 	if (instance == nullptr) return BB_FAILURE;
 
 	instance->s_configuration_mutex.lock();
 
-	instance->s_callback_functions.error_callback = callback_function_ptr;
+	instance->s_tracking_parameters = tracking_parameters;
 
 	instance->s_configuration_mutex.unlock();
 
 	return BB_SUCCESS;
 }
 
-BbResult bbStartAreaCalibration(
+BbTrackingParameters bbGetTrackingParameters(
 	BbInstance a_instance) {
 
 	BbInstance_T* instance = castInstance(a_instance);
-	if (instance == nullptr) return BB_FAILURE;
+	if (instance == nullptr) return BbTrackingParameters{};
 
 	instance->s_configuration_mutex.lock();
 
+	BbTrackingParameters tracking_parameters = instance->s_tracking_parameters;
+
+	instance->s_configuration_mutex.unlock();
+
+	return tracking_parameters;
+}
+
+BbResult bbSetAudioParameters(
+	BbInstance a_instance,
+	BbAudioParameters audio_parameters) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	instance->s_audio_mutex.lock();
+
+	instance->s_audio_parameters = audio_parameters;
+	instance->s_audio_detector.threshold = audio_parameters.onset_threshold;
+
+	instance->s_audio_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbPushAudioSamples(
+	BbInstance a_instance,
+	const int16_t* samples,
+	uint32_t sample_count,
+	uint32_t sample_rate) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr || samples == nullptr || sample_rate == 0) return BB_FAILURE;
+
 	//
-	//	Inside this function we are opening and releasing
-	//	the video source to avoid accessing the webcam constantly.
+	//	The samples are placed on the clock of the camera, the frames of
+	//	a video file have their own one that a microphone can't follow
 	//
-	instance->s_video->open(0);
+	instance->s_configuration_mutex.lock();
+	bool using_video_file = instance->s_configuration_parameters.using_video_file;
+	instance->s_configuration_mutex.unlock();
+
+	if (using_video_file) return BB_FAILURE;
+
+	instance->s_audio_mutex.lock();
+
+	double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - instance->s_launch_time).count();
 
 	//
-	//	We destroy all windows to get ready for a possible
-	//	next execution
+	//	A microphone replaces the file, and a new sample rate
+	//	means a new stream so we start the detector over
 	//
-	cv::destroyAllWindows();
+	instance->s_audio_file_samples.clear();
 
-	instance->s_is_calibrating_projection = true;
+	if (instance->s_audio_detector.sample_rate != (int)sample_rate) {
+		audio_init(&instance->s_audio_detector, (int)sample_rate, instance->s_audio_parameters.onset_threshold);
+	}
 
-	instance->s_calibration_state.have_matrix = false;
+	double start_time = now - instance->s_audio_parameters.latency - (double)sample_count / sample_rate;
+	audio_process(&instance->s_audio_detector, samples, sample_count, start_time);
 
-	instance->s_calibration_state.square_points.clear();
+	instance->s_audio_mutex.unlock();
 
-	instance->s_calibration_state.average_points.clear();
+	return BB_SUCCESS;
+}
 
-	instance->s_calibration_state.homography_matrix = cv::Mat();
+BbResult bbSetAudioFile(
+	BbInstance a_instance,
+	const char* path) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	std::vector<int16_t> samples;
+	int sample_rate = 0;
+
+	if (path != nullptr && !audio_loadWav(path, &samples, &sample_rate)) {
+		return BB_FAILURE;
+	}
+
+	instance->s_audio_mutex.lock();
+
+	instance->s_audio_file_samples.swap(samples);
+	instance->s_audio_file_position = 0;
+	audio_init(&instance->s_audio_detector, sample_rate, instance->s_audio_parameters.onset_threshold);
+
+	instance->s_audio_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbSetHitZones(
+	BbInstance a_instance,
+	const BbHitZone* zones,
+	uint32_t zone_count) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr || (zones == nullptr && zone_count > 0)) return BB_FAILURE;
 
 	//
-	//	@TODO: Complete and probably erase the previous values
-	//	that represent the calibration (Homography matrices, 
-	//	points that define the squares, etc.).
+	//	Built here on the thread of the host, the processing
+	//	keeps using the old zones until we swap them
 	//
+	std::shared_ptr<ZoneIndex> zone_index = std::make_shared<ZoneIndex>();
+	zones_build(zone_index.get(), zones, zone_count);
 
-	instance->s_configuration_mutex.unlock();
+	std::atomic_store(&instance->s_zone_index, std::shared_ptr<const ZoneIndex>(zone_index));
 
 	return BB_SUCCESS;
 }
 
-BbAreaCalibration bbEndAreaCalibration(
-	BbInstance a_instance) {
+BbResult bbSetProjectionAreas(
+	BbInstance a_instance,
+	const BbProjectionArea* areas,
+	uint32_t area_count) {
 
 	BbInstance_T* instance = castInstance(a_instance);
-	if (instance == nullptr) return BbAreaCalibration{};
+	if (instance == nullptr) return BB_FAILURE;
 
+	if (areas == NULL && area_count > 0) {
+		return BB_FAILURE;
+	}
 
-	std::vector<cv::Point2f> normal_values;
-	normal_values.push_back(cv::Point2f(0.f, 1.f));
-	normal_values.push_back(cv::Point2f(1.f, 1.f));
-	normal_values.push_back(cv::Point2f(1.f, 0.f));
-	normal_values.push_back(cv::Point2f(0.f, 0.f));
+	instance->s_configuration_mutex.lock();
+
+	setProjectionAreas(instance, areas, area_count);
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbSetCoordinateCallback(
+	BbInstance a_instance,
+	BbCoordinateCallback callback_function_ptr) {
 
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
 
 	instance->s_configuration_mutex.lock();
 
+	instance->s_callback_functions.coordinate_callback = callback_function_ptr;
 
-	if (instance->s_calibration_state.square_points.size() <= 0) {
+	instance->s_configuration_mutex.unlock();
 
-		manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_CALIBRATE);
+	return BB_SUCCESS;
+}
 
-		cv::destroyAllWindows();
+BbResult bbSetImpactCallback(
+	BbInstance a_instance,
+	BbImpactCallback callback_function_ptr) {
 
-		instance->s_video->release();
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
 
-		instance->s_is_calibrating_projection = false;
+	instance->s_configuration_mutex.lock();
 
-		instance->s_calibration_state.have_matrix = true;
-		instance->s_calibration_state.average_points.clear();
-		instance->s_calibration_state.square_points.clear();
-		instance->s_calibration_state.homography_matrix = cv::Mat();
+	instance->s_callback_functions.impact_callback = callback_function_ptr;
 
-		instance->s_configuration_mutex.unlock();
+	instance->s_configuration_mutex.unlock();
 
-		return BbAreaCalibration();
+	return BB_SUCCESS;
+}
 
-	}
+BbResult bbSetErrorCallback(
+	BbInstance a_instance,
+	BbErrorCallback callback_function_ptr) {
 
-	instance->s_calibration_state.average_points.clear();
-	instance->s_calibration_state.average_points.push_back(cv::Point2f(0.f, 0.f));
-	instance->s_calibration_state.average_points.push_back(cv::Point2f(0.f, 0.f));
-	instance->s_calibration_state.average_points.push_back(cv::Point2f(0.f, 0.f));
-	instance->s_calibration_state.average_points.push_back(cv::Point2f(0.f, 0.f));
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
 
+	instance->s_configuration_mutex.lock();
 
-	for (std::vector<cv::Point2f> vec : instance->s_calibration_state.square_points) {
+	instance->s_callback_functions.error_callback = callback_function_ptr;
 
-		for (short i = 0; i < 4; i++) {
-			instance->s_calibration_state.average_points[i] += vec[i];
-		}
+	instance->s_configuration_mutex.unlock();
 
-	}
+	return BB_SUCCESS;
+}
 
-	for (short i = 0; i < 4; i++) {
-		instance->s_calibration_state.average_points[i] /= (float)instance->s_calibration_state.square_points.size();
-	}
+BbResult bbStartAreaCalibration(
+	BbInstance a_instance) {
 
-	utilscv_sortSquarePoints(&(instance->s_calibration_state.average_points));
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
 
-	BbAreaCalibration projection_calibration;
+	instance->s_configuration_mutex.lock();
 
-	projection_calibration.point_0.x = instance->s_calibration_state.average_points[0].x;
-	projection_calibration.point_0.y = instance->s_calibration_state.average_points[0].y;
+	//
+	//	The camera is only opened when a bbCalibrateArea* function needs
+	//	a frame from it and released at the end, so hosts that send their
+	//	own frames keep it. The windows are the same, only the functions
+	//	that show them open them and they are destroyed at the end.
+	//
+	instance->s_calibration_state.shown_windows = false;
+
+	instance->s_is_calibrating_projection = true;
+
+	instance->s_calibration_state.have_matrix = false;
+
+	if (instance->s_stereo.camera_index >= 0) {
+		instance->s_stereo.video->open(instance->s_stereo.camera_index);
+	}
 
-	projection_calibration.point_1.x = instance->s_calibration_state.average_points[1].x;
-	projection_calibration.point_1.y = instance->s_calibration_state.average_points[1].y;
+	instance->s_stereo.have_matrix = false;
+	corners_reset(&instance->s_stereo.corners);
+	instance->s_stereo.area_points.clear();
+	instance->s_stereo.homography_matrix = cv::Mat();
 
-	projection_calibration.point_2.x = instance->s_calibration_state.average_points[2].x;
-	projection_calibration.point_2.y = instance->s_calibration_state.average_points[2].y;
+	corners_reset(&instance->s_calibration_state.corners);
 
-	projection_calibration.point_3.x = instance->s_calibration_state.average_points[3].x;
-	projection_calibration.point_3.y = instance->s_calibration_state.average_points[3].y;
+	instance->s_calibration_state.average_points.clear();
 
+	instance->s_calibration_state.area_points.clear();
 
-	instance->s_calibration_state.homography_matrix = findHomography(instance->s_calibration_state.average_points, normal_values);
+	instance->s_calibration_state.homography_matrix = cv::Mat();
 
 	//
-	//	We destroy all windows to get ready for a possible
-	//	next execution
+	//	@TODO: Complete and probably erase the previous values
+	//	that represent the calibration (Homography matrices, 
+	//	points that define the squares, etc.).
 	//
-	cv::destroyAllWindows();
 
-	instance->s_video->release();
+	instance->s_configuration_mutex.unlock();
 
-	instance->s_is_calibrating_projection = false;
+	return BB_SUCCESS;
+}
+
+BbAreaCalibration bbEndAreaCalibration(
+	BbInstance a_instance) {
 
-	instance->s_calibration_state.have_matrix = true;
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BbAreaCalibration{};
+
+
+	instance->s_configuration_mutex.lock();
+
+	BbAreaCalibration projection_calibration = finishAreaCalibration(instance);
 
 	instance->s_configuration_mutex.unlock();
 
 	return projection_calibration;
 }
 
+BbResult bbSetAreaCalibrationParameters(
+	BbInstance a_instance,
+	BbAreaCalibrationParameters parameters) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	instance->s_configuration_mutex.lock();
+
+	instance->s_calibration_state.parameters = parameters;
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbSetAreaCalibrationCallback(
+	BbInstance a_instance,
+	BbAreaCalibrationCallback callback_function_ptr) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	instance->s_configuration_mutex.lock();
+
+	instance->s_callback_functions.area_calibration_callback = callback_function_ptr;
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
 BbResult bbCalibrateAreaWithClick(
 	BbInstance a_instance,
 	int hue_threshold,
@@ -628,6 +1433,13 @@ BbResult bbCalibrateAreaWithClick(
 			return BB_FAILURE;
 		}
 
+		if (!openCalibrationCamera(instance)) {
+			instance->s_configuration_mutex.unlock();
+			return BB_FAILURE;
+		}
+
+		instance->s_calibration_state.shown_windows = true;
+
 
 		//
 		//	We wait a bit to have a clear frame
@@ -774,7 +1586,7 @@ BbResult bbCalibrateAreaWithClick(
 					//
 					//	We sabe the calibration points for this iteration of the calibration
 					//
-					instance->s_calibration_state.square_points.push_back(processed_contour);
+					corners_add(&instance->s_calibration_state.corners, processed_contour, &instance->s_calibration_state.parameters);
 				}
 
 
@@ -792,6 +1604,23 @@ BbResult bbCalibrateAreaWithClick(
 
 		}
 
+		//
+		//	The area has the colour we clicked for the second camera too
+		//
+		calibrateStereoArea(instance,
+			cv::Scalar(hsv_base[0] - hue_threshold,
+				hsv_base[1] - saturation_threshold,
+				hsv_base[2] - value_threshold),
+			cv::Scalar(hsv_base[0] + hue_threshold,
+				hsv_base[1] + saturation_threshold,
+				hsv_base[2] + value_threshold),
+			instance->s_configuration_parameters.output_frames);
+
+		//
+		//	Once the corners stop moving we are done
+		//
+		checkAreaCalibration(instance);
+
 		//
 		//	ANd we wait a bit after the calibration to be able to see
 		//	the frames if needed
@@ -828,6 +1657,13 @@ BbResult bbCalibrateAreaWithHSVRanges(
 		return BB_FAILURE;
 	}
 
+	if (!openCalibrationCamera(instance)) {
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	instance->s_calibration_state.shown_windows = true;
+
 
 	//
 	//	We wait a bit to have a clear frame
@@ -958,7 +1794,7 @@ BbResult bbCalibrateAreaWithHSVRanges(
 				//
 				//	We sabe the calibration points for this iteration of the calibration
 				//
-				instance->s_calibration_state.square_points.push_back(processed_contour);
+				corners_add(&instance->s_calibration_state.corners, processed_contour, &instance->s_calibration_state.parameters);
 			}
 
 
@@ -976,6 +1812,16 @@ BbResult bbCalibrateAreaWithHSVRanges(
 
 	}
 
+	calibrateStereoArea(instance,
+		cv::Scalar(iLowH, a_low_s, a_low_v),
+		cv::Scalar(a_high_h, a_high_s, a_high_v),
+		instance->s_configuration_parameters.output_frames);
+
+	//
+	//	Once the corners stop moving we are done
+	//
+	checkAreaCalibration(instance);
+
 	//
 	//	ANd we wait a bit after the calibration to be able to see
 	//	the frames if needed
@@ -993,31 +1839,204 @@ BbResult bbCalibrateAreaWithHSVRanges(
 	return BB_SUCCESS;
 }
 
-BbResult bbCalibrateBallWithClick(
+BbResult bbStartPatternCalibration(
 	BbInstance a_instance,
-	int hue_threshold,
-	int saturation_threshold,
-	int value_threshold) {
+	int projector_width,
+	int projector_height,
+	int* pattern_count) {
 
 	BbInstance_T* instance = castInstance(a_instance);
-	if (instance == nullptr) return BB_FAILURE;
-	
-	cv::Mat clean_frame, frame, mask;
+	if (instance == nullptr || projector_width <= 0 || projector_height <= 0) return BB_FAILURE;
+
+	//
+	//	The same as any area calibration, the patterns
+	//	are just a better way of finding the corners
+	//
+	if (bbStartAreaCalibration(a_instance) != BB_SUCCESS) {
+		return BB_FAILURE;
+	}
 
 	instance->s_configuration_mutex.lock();
-	{
 
-		instance->s_video->open(0);
+	patterns_reset(&instance->s_calibration_state.patterns, projector_width, projector_height);
+	patterns_reset(&instance->s_stereo.patterns, projector_width, projector_height);
 
-		//
-		//	We wait a bit to have a clear frame
-		//
-		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	instance->s_configuration_mutex.unlock();
 
-		for (short i = 0; i < CALIBRATION_WARMUP; i++) {
-			if (!instance->s_video->read(clean_frame)) {
-				manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
-				return BB_FAILURE;
+	if (pattern_count != nullptr) {
+		*pattern_count = PATTERNS_COUNT;
+	}
+
+	return BB_SUCCESS;
+}
+
+BbResult bbGetCalibrationPattern(
+	BbInstance a_instance,
+	int pattern_index,
+	uint8_t* pixels,
+	int stride) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr || pixels == nullptr) return BB_FAILURE;
+
+	instance->s_configuration_mutex.lock();
+
+	const PatternDecoder * decoder = &instance->s_calibration_state.patterns;
+	bool rendered = false;
+
+	if (instance->s_is_calibrating_projection && !decoder->captures.empty() && stride >= decoder->projector_width) {
+		cv::Mat image(decoder->projector_height, decoder->projector_width, CV_8UC1, pixels, (size_t)stride);
+		rendered = patterns_render(decoder, pattern_index, image);
+	}
+
+	instance->s_configuration_mutex.unlock();
+
+	return (rendered ? BB_SUCCESS : BB_FAILURE);
+}
+
+BbResult bbShowingCalibrationPattern(
+	BbInstance a_instance,
+	int pattern_index,
+	const BbFrame* frame) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	instance->s_configuration_mutex.lock();
+
+	if (!instance->s_is_calibrating_projection) {
+		manageError(instance->s_callback_functions.error_callback, BbError::NOT_IN_CALIBRATION_MODE);
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	//
+	//	The patterns are decoded at the resolution we detect the ball
+	//	at, so the corners are already in the coordinates of the blobs
+	//
+	cv::Mat clean_frame;
+	if (!getCalibrationFrame(instance, frame, PATTERN_SETTLE_FRAMES, &clean_frame)) {
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	utilscv_resize(&clean_frame, instance->s_configuration_parameters.target_internal_resolution);
+
+	if (!patterns_add(&instance->s_calibration_state.patterns, pattern_index, clean_frame)) {
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	//
+	//	The second camera sees the same pattern
+	//
+	StereoState * stereo = &instance->s_stereo;
+	if (stereo->camera_index >= 0 && stereo->video->isOpened()) {
+
+		cv::Mat stereo_frame;
+		for (int i = 0; i < PATTERN_SETTLE_FRAMES; i++) {
+			if (!stereo->video->read(stereo_frame)) {
+				manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+				instance->s_configuration_mutex.unlock();
+				return BB_FAILURE;
+			}
+		}
+
+		utilscv_resize(&stereo_frame, instance->s_configuration_parameters.target_internal_resolution);
+		patterns_add(&stereo->patterns, pattern_index, stereo_frame);
+	}
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbAreaCalibration bbEndPatternCalibration(
+	BbInstance a_instance) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BbAreaCalibration{};
+
+	instance->s_configuration_mutex.lock();
+
+	CalibrationState * state = &instance->s_calibration_state;
+	StereoState * stereo = &instance->s_stereo;
+
+	//
+	//	The corners decoded go to the calibration as its only detection,
+	//	so it finishes like the other area calibrations do
+	//
+	std::vector<cv::Point2f> corners;
+	float reprojection_error = 0.0f;
+	float inlier_ratio = 0.0f;
+	bool decoded = false;
+
+	if (instance->s_is_calibrating_projection) {
+
+		decoded = patterns_decode(&state->patterns, &corners, &reprojection_error, &inlier_ratio);
+
+		corners_reset(&state->corners);
+		if (decoded) {
+			utilscv_sortSquarePoints(&corners);
+			corners_add(&state->corners, corners, &state->parameters);
+		}
+
+		std::vector<cv::Point2f> stereo_corners;
+		float stereo_error, stereo_inlier_ratio;
+
+		corners_reset(&stereo->corners);
+		if (stereo->camera_index >= 0 &&
+			patterns_decode(&stereo->patterns, &stereo_corners, &stereo_error, &stereo_inlier_ratio)) {
+			utilscv_sortSquarePoints(&stereo_corners);
+			corners_add(&stereo->corners, stereo_corners, &state->parameters);
+		}
+	}
+
+	BbAreaCalibration projection_calibration = finishAreaCalibration(instance);
+
+	if (decoded) {
+		state->reprojection_error = reprojection_error;
+		state->inlier_ratio = inlier_ratio;
+		projection_calibration.reprojection_error = reprojection_error;
+		projection_calibration.inlier_ratio = inlier_ratio;
+	}
+
+	//
+	//	The frames of the patterns are big, we don't need them anymore
+	//
+	state->patterns.captures.clear();
+	stereo->patterns.captures.clear();
+
+	instance->s_configuration_mutex.unlock();
+
+	return projection_calibration;
+}
+
+BbResult bbCalibrateBallWithClick(
+	BbInstance a_instance,
+	int hue_threshold,
+	int saturation_threshold,
+	int value_threshold) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+	
+	cv::Mat clean_frame, frame, mask;
+
+	instance->s_configuration_mutex.lock();
+	{
+
+		instance->s_video->open(instance->s_camera_index);
+
+		//
+		//	We wait a bit to have a clear frame
+		//
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		for (short i = 0; i < CALIBRATION_WARMUP; i++) {
+			if (!instance->s_video->read(clean_frame)) {
+				manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+				return BB_FAILURE;
 			}
 			cv::waitKey(1);
 		}
@@ -1055,95 +2074,2189 @@ BbResult bbCalibrateBallWithClick(
 			int k = cv::waitKey(10);
 		}
 
-		instance->s_ball_detection_parameters.h_low = hsv_base_low[0];
-		instance->s_ball_detection_parameters.s_low = hsv_base_low[1];
-		instance->s_ball_detection_parameters.v_low = hsv_base_low[2];
+		setBallRanges(instance, hsv_base_low, hsv_base_high, hue_threshold, saturation_threshold, value_threshold);
 
-		instance->s_ball_detection_parameters.h_high = hsv_base_high[0];
-		instance->s_ball_detection_parameters.s_high = hsv_base_high[1];
-		instance->s_ball_detection_parameters.v_high = hsv_base_high[2];
 
-		reorderBallRanges(instance);
+		instance->s_video->release();
 
-		instance->s_ball_detection_parameters.h_low -= hue_threshold;
-		instance->s_ball_detection_parameters.s_low -= saturation_threshold;
-		instance->s_ball_detection_parameters.v_low -= value_threshold;
+		cv::destroyAllWindows();
+	}
 
-		instance->s_ball_detection_parameters.h_high += hue_threshold;
-		instance->s_ball_detection_parameters.s_high += saturation_threshold;
-		instance->s_ball_detection_parameters.v_high += value_threshold;
+	instance->s_configuration_mutex.unlock();
 
-		//
-		//	@@DOING: Setting saturation and value to broad ranges
-		//
-		instance->s_ball_detection_parameters.s_low = 100;
-		instance->s_ball_detection_parameters.s_high = 255;
-		instance->s_ball_detection_parameters.v_low = 30;
-		instance->s_ball_detection_parameters.v_high = 255;
+	return BB_SUCCESS;
+}
+
+BbResult bbCalibrateAreaAtPoint(
+	BbInstance a_instance,
+	const BbFrame* frame,
+	int x,
+	int y,
+	int hue_threshold,
+	int saturation_threshold,
+	int value_threshold) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
 
+	instance->s_configuration_mutex.lock();
+
+	if (!instance->s_is_calibrating_projection) {
+		manageError(instance->s_callback_functions.error_callback, BbError::NOT_IN_CALIBRATION_MODE);
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	cv::Mat clean_frame;
+	if (!getCalibrationFrame(instance, frame, CALIBRATION_WARMUP, &clean_frame)) {
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	cv::Vec3b hsv_base;
+	if (!sampleHSV(clean_frame, cv::Point(x, y), &hsv_base)) {
+		manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_CALIBRATE);
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	cv::Scalar hsv_low(hsv_base[0] - hue_threshold, hsv_base[1] - saturation_threshold, hsv_base[2] - value_threshold);
+	cv::Scalar hsv_high(hsv_base[0] + hue_threshold, hsv_base[1] + saturation_threshold, hsv_base[2] + value_threshold);
+
+	calibrateAreaFrame(instance, clean_frame, hsv_low, hsv_high);
+
+	//
+	//	The second camera is still ours, it looks for the same colour
+	//
+	calibrateStereoArea(instance, hsv_low, hsv_high, false);
+
+	checkAreaCalibration(instance);
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbCalibrateBallAtPoints(
+	BbInstance a_instance,
+	const BbFrame* frame,
+	int dark_x,
+	int dark_y,
+	int lit_x,
+	int lit_y,
+	int hue_threshold,
+	int saturation_threshold,
+	int value_threshold) {
 
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	instance->s_configuration_mutex.lock();
+
+	cv::Mat clean_frame;
+	bool have_frame = getCalibrationFrame(instance, frame, CALIBRATION_WARMUP, &clean_frame);
+
+	//
+	//	Like with the clicks, we only hold the camera while calibrating
+	//
+	if (frame == nullptr) {
 		instance->s_video->release();
+	}
 
-		cv::destroyAllWindows();
+	if (!have_frame) {
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	cv::Vec3b hsv_dark, hsv_lit;
+	if (!sampleHSV(clean_frame, cv::Point(dark_x, dark_y), &hsv_dark) ||
+		!sampleHSV(clean_frame, cv::Point(lit_x, lit_y), &hsv_lit)) {
+		manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_CALIBRATE);
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
 	}
 
+	setBallRanges(instance, hsv_dark, hsv_lit, hue_threshold, saturation_threshold, value_threshold);
+
 	instance->s_configuration_mutex.unlock();
 
 	return BB_SUCCESS;
 }
 
-BbCalibrationSettings bbGetCalibrationSettings(BbInstance a_instance) {
+BbResult bbCalibrateBallAutomatically(
+	BbInstance a_instance,
+	float duration,
+	BbBallColorCalibration* calibration) {
 
 	BbInstance_T* instance = castInstance(a_instance);
-	if (instance == nullptr) return BbCalibrationSettings{};
+	if (instance == nullptr) return BB_FAILURE;
 
-	BbCalibrationSettings calibration_settings;
+	if (calibration != nullptr) {
+		*calibration = BbBallColorCalibration{};
+	}
 
 	instance->s_configuration_mutex.lock();
 
-	{
+	instance->s_video->open(instance->s_camera_index);
 
-		BbAreaCalibration projection_calibration_aux;
+	//
+	//	The ball is the only thing moving in front of the camera, so whatever
+	//	the background model doesn't expect is the ball. The shadows it finds
+	//	are neither ball nor background, and neither is the border of the
+	//	ball, where the pixels mix both colours.
+	//
+	cv::Ptr<cv::BackgroundSubtractorMOG2> subtractor =
+		cv::createBackgroundSubtractorMOG2(BALL_CALIBRATION_HISTORY, 16.0, true);
 
-		if (instance->s_calibration_state.have_matrix && instance->s_calibration_state.average_points.size() > 0) {
-			//
-			//	Setting the points that define the square on the screen
-			//
-			projection_calibration_aux.point_0.x = instance->s_calibration_state.average_points[0].x;
-			projection_calibration_aux.point_0.y = instance->s_calibration_state.average_points[0].y;
+	ColorHistogram ball_histogram, background_histogram;
+	ballcolor_reset(&ball_histogram);
+	ballcolor_reset(&background_histogram);
 
-			projection_calibration_aux.point_1.x = instance->s_calibration_state.average_points[1].x;
-			projection_calibration_aux.point_1.y = instance->s_calibration_state.average_points[1].y;
+	cv::Mat clean_frame, hsv_frame, foreground, ball_mask, background_mask;
 
-			projection_calibration_aux.point_2.x = instance->s_calibration_state.average_points[2].x;
-			projection_calibration_aux.point_2.y = instance->s_calibration_state.average_points[2].y;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int frame_count = 0;
 
-			projection_calibration_aux.point_3.x = instance->s_calibration_state.average_points[3].x;
-			projection_calibration_aux.point_3.y = instance->s_calibration_state.average_points[3].y;
+	while (std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() < duration ||
+		frame_count < CALIBRATION_WARMUP) {
 
-			projection_calibration_aux.valid = true;
+		if (!instance->s_video->read(clean_frame)) {
+			manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+			instance->s_video->release();
+			instance->s_configuration_mutex.unlock();
+			return BB_FAILURE;
+		}
 
-			calibration_settings.projection_calibration = projection_calibration_aux;
+		utilscv_resize(&clean_frame, instance->s_configuration_parameters.target_internal_resolution);
+		subtractor->apply(clean_frame, foreground);
+
+		//
+		//	The first frames only teach the model what the background is
+		//
+		if (frame_count++ < CALIBRATION_WARMUP) {
+			continue;
 		}
-		else {
-			projection_calibration_aux.valid = false;
+
+		cv::compare(foreground, 255, ball_mask, cv::CMP_EQ);
+		cv::erode(ball_mask, ball_mask, cv::Mat(), cv::Point(-1, -1), BALL_CALIBRATION_MORPHOLOGY_ITERATIONS);
+		cv::dilate(ball_mask, ball_mask, cv::Mat(), cv::Point(-1, -1), BALL_CALIBRATION_MORPHOLOGY_ITERATIONS);
+
+		cv::dilate(foreground, background_mask, cv::Mat(), cv::Point(-1, -1), BALL_CALIBRATION_MORPHOLOGY_ITERATIONS);
+		cv::compare(background_mask, 0, background_mask, cv::CMP_EQ);
+
+		cv::cvtColor(clean_frame, hsv_frame, CV_BGR2HSV);
+		ballcolor_add(&ball_histogram, hsv_frame, ball_mask);
+		ballcolor_add(&background_histogram, hsv_frame, background_mask);
+
+		if (instance->s_configuration_parameters.output_frames) {
+			cv::imshow("ball_calibration", ball_mask);
+			cv::waitKey(1);
 		}
+	}
+
+	instance->s_video->release();
+
+	BallColorFit fit;
+	if (!ballcolor_fit(&ball_histogram, &background_histogram, &fit)) {
+		manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_CALIBRATE);
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	instance->s_ball_detection_parameters.h_low = fit.h_low;
+	instance->s_ball_detection_parameters.h_high = fit.h_high;
+	instance->s_ball_detection_parameters.s_low = fit.s_low;
+	instance->s_ball_detection_parameters.s_high = fit.s_high;
+	instance->s_ball_detection_parameters.v_low = fit.v_low;
+	instance->s_ball_detection_parameters.v_high = fit.v_high;
+
+	if (calibration != nullptr) {
+		calibration->ball_coverage = fit.ball_coverage;
+		calibration->background_coverage = fit.background_coverage;
+		calibration->valid = true;
+	}
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbStartIntrinsicsCalibration(
+	BbInstance a_instance) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	instance->s_configuration_mutex.lock();
+
+	//
+	//	Same as with the area, we open the video source
+	//	now and release it when the calibration ends
+	//
+	instance->s_video->open(instance->s_camera_index);
+
+	cv::destroyAllWindows();
+
+	instance->s_is_calibrating_intrinsics = true;
+
+	instance->s_calibration_state.intrinsics_image_points.clear();
+	instance->s_calibration_state.intrinsics_object_points.clear();
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbCalibrateIntrinsicsWithChessboard(
+	BbInstance a_instance,
+	int inner_columns,
+	int inner_rows) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	cv::Mat clean_frame, gray;
+
+	instance->s_configuration_mutex.lock();
+
+	if (!instance->s_is_calibrating_intrinsics) {
+		manageError(instance->s_callback_functions.error_callback, BbError::NOT_IN_CALIBRATION_MODE);
+		instance->s_configuration_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	for (short i = 0; i < CALIBRATION_WARMUP; i++) {
+		if (!instance->s_video->read(clean_frame)) {
+			manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+			instance->s_configuration_mutex.unlock();
+			return BB_FAILURE;
+		}
+		cv::waitKey(1);
+	}
+
+	//
+	//	The same resolution we process the frames at, so the
+	//	intrinsics fit the positions we correct
+	//
+	utilscv_resize(&clean_frame, instance->s_configuration_parameters.target_internal_resolution);
+	cv::cvtColor(clean_frame, gray, CV_BGR2GRAY);
+
+	cv::Size pattern_size(inner_columns, inner_rows);
+	std::vector<cv::Point2f> corners;
+
+	bool found = cv::findChessboardCorners(gray, pattern_size, corners,
+		cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE);
+
+	if (found) {
+
+		cv::cornerSubPix(gray, corners, cv::Size(5, 5), cv::Size(-1, -1),
+			cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.01));
+
+		//
+		//	The size of the squares doesn't change the intrinsics
+		//	so the chessboard is in units of squares
+		//
+		std::vector<cv::Point3f> board;
+		for (int row = 0; row < inner_rows; row++) {
+			for (int column = 0; column < inner_columns; column++) {
+				board.push_back(cv::Point3f((float)column, (float)row, 0.0f));
+			}
+		}
+
+		instance->s_calibration_state.intrinsics_image_points.push_back(corners);
+		instance->s_calibration_state.intrinsics_object_points.push_back(board);
+		instance->s_calibration_state.intrinsics_image_size = clean_frame.size();
+	}
+
+	if (instance->s_configuration_parameters.output_frames) {
+		cv::drawChessboardCorners(clean_frame, pattern_size, corners, found);
+		cv::imshow("clean_frame", clean_frame);
+		cv::waitKey(1);
+	}
+
+	instance->s_configuration_mutex.unlock();
+
+	return (found ? BB_SUCCESS : BB_FAILURE);
+}
+
+BbCameraIntrinsics bbEndIntrinsicsCalibration(
+	BbInstance a_instance) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BbCameraIntrinsics{};
+
+	instance->s_configuration_mutex.lock();
+
+	CalibrationState * state = &instance->s_calibration_state;
+
+	cv::destroyAllWindows();
+
+	instance->s_video->release();
+
+	instance->s_is_calibrating_intrinsics = false;
+
+	if (state->intrinsics_image_points.size() < INTRINSICS_MIN_VIEWS) {
+
+		manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_CALIBRATE);
+
+		instance->s_configuration_mutex.unlock();
+
+		return BbCameraIntrinsics();
+	}
+
+	cv::Mat camera_matrix, distortion;
+	std::vector<cv::Mat> rotations, translations;
+
+	double reprojection_error = cv::calibrateCamera(
+		state->intrinsics_object_points,
+		state->intrinsics_image_points,
+		state->intrinsics_image_size,
+		camera_matrix, distortion, rotations, translations);
+
+	BbCameraIntrinsics intrinsics;
+
+	intrinsics.fx = camera_matrix.at<double>(0, 0);
+	intrinsics.fy = camera_matrix.at<double>(1, 1);
+	intrinsics.cx = camera_matrix.at<double>(0, 2);
+	intrinsics.cy = camera_matrix.at<double>(1, 2);
+
+	for (int i = 0; i < 5 && i < (int)distortion.total(); i++) {
+		intrinsics.distortion[i] = distortion.at<double>(i);
+	}
+
+	intrinsics.image_width = state->intrinsics_image_size.width;
+	intrinsics.image_height = state->intrinsics_image_size.height;
+	intrinsics.reprojection_error = reprojection_error;
+	intrinsics.valid = true;
+
+	state->camera_intrinsics = intrinsics;
+
+	state->intrinsics_image_points.clear();
+	state->intrinsics_object_points.clear();
+
+	//
+	//	The area we already had was seen through the lens
+	//
+	if (state->have_matrix && state->area_points.size() == 4) {
+		updateHomography(instance);
+	}
+
+	instance->s_configuration_mutex.unlock();
+
+	return intrinsics;
+}
+
+BbResult bbSetCameraIntrinsics(
+	BbInstance a_instance,
+	BbCameraIntrinsics camera_intrinsics) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	instance->s_configuration_mutex.lock();
+
+	instance->s_calibration_state.camera_intrinsics = camera_intrinsics;
+
+	if (instance->s_calibration_state.have_matrix && instance->s_calibration_state.area_points.size() == 4) {
+		updateHomography(instance);
+	}
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbCalibrationSettings bbGetCalibrationSettings(BbInstance a_instance) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BbCalibrationSettings{};
+
+	BbCalibrationSettings calibration_settings;
+
+	instance->s_configuration_mutex.lock();
+
+	{
+
+		BbAreaCalibration projection_calibration_aux;
+
+		if (instance->s_calibration_state.have_matrix && instance->s_calibration_state.area_points.size() > 0) {
+			//
+			//	Setting the points that define the square on the screen
+			//
+			projection_calibration_aux.point_0.x = instance->s_calibration_state.area_points[0].x;
+			projection_calibration_aux.point_0.y = instance->s_calibration_state.area_points[0].y;
+
+			projection_calibration_aux.point_1.x = instance->s_calibration_state.area_points[1].x;
+			projection_calibration_aux.point_1.y = instance->s_calibration_state.area_points[1].y;
+
+			projection_calibration_aux.point_2.x = instance->s_calibration_state.area_points[2].x;
+			projection_calibration_aux.point_2.y = instance->s_calibration_state.area_points[2].y;
+
+			projection_calibration_aux.point_3.x = instance->s_calibration_state.area_points[3].x;
+			projection_calibration_aux.point_3.y = instance->s_calibration_state.area_points[3].y;
+
+			projection_calibration_aux.reprojection_error = instance->s_calibration_state.reprojection_error;
+			projection_calibration_aux.inlier_ratio = instance->s_calibration_state.inlier_ratio;
+
+			projection_calibration_aux.valid = true;
+
+			calibration_settings.projection_calibration = projection_calibration_aux;
+		}
+		else {
+			projection_calibration_aux.valid = false;
+		}
+
+		//
+		//	Setting the ball parameters
+		//
+		calibration_settings.ball_detection_parameters = instance->s_ball_detection_parameters;
+
+		calibration_settings.camera_intrinsics = instance->s_calibration_state.camera_intrinsics;
+
+		if (instance->s_stereo.have_matrix && instance->s_stereo.area_points.size() == 4) {
+
+			BbAreaCalibration & stereo_calibration = calibration_settings.stereo_projection_calibration;
+			BbPoint2d * points[4] = {
+				&stereo_calibration.point_0, &stereo_calibration.point_1,
+				&stereo_calibration.point_2, &stereo_calibration.point_3 };
+
+			for (short i = 0; i < 4; i++) {
+				points[i]->x = instance->s_stereo.area_points[i].x;
+				points[i]->y = instance->s_stereo.area_points[i].y;
+			}
+
+			stereo_calibration.valid = true;
+		}
+
+		const std::vector<ProjectionArea> & projection_areas = instance->s_calibration_state.projection_areas;
+		calibration_settings.projection_area_count = (uint32_t)projection_areas.size();
+
+		for (size_t i = 0; i < projection_areas.size(); i++) {
+
+			BbProjectionArea & area = calibration_settings.projection_areas[i];
+			BbPoint2d * points[4] = {
+				&area.calibration.point_0, &area.calibration.point_1,
+				&area.calibration.point_2, &area.calibration.point_3 };
+
+			area.area_id = projection_areas[i].area_id;
+			for (short j = 0; j < 4; j++) {
+				points[j]->x = projection_areas[i].area_points[j].x;
+				points[j]->y = projection_areas[i].area_points[j].y;
+			}
+			area.calibration.valid = true;
+		}
+	}
+
+	instance->s_configuration_mutex.unlock();
+
+	return calibration_settings;
+}
+
+BbResult bbSetCalibrationSettings(BbInstance a_instance, BbCalibrationSettings calibration_settings) {
+
+	BbInstance_T* instance = castInstance(a_instance);
+	if (instance == nullptr) return BB_FAILURE;
+
+	instance->s_configuration_mutex.lock();
+
+	{
+
+		instance->s_ball_detection_parameters = calibration_settings.ball_detection_parameters;
+
+		instance->s_calibration_state.camera_intrinsics = calibration_settings.camera_intrinsics;
+
+		setProjectionAreas(instance, calibration_settings.projection_areas, calibration_settings.projection_area_count);
+
+		const BbAreaCalibration & stereo_calibration = calibration_settings.stereo_projection_calibration;
+		instance->s_stereo.have_matrix = stereo_calibration.valid;
+
+		if (stereo_calibration.valid) {
+
+			const BbPoint2d * points[4] = {
+				&stereo_calibration.point_0, &stereo_calibration.point_1,
+				&stereo_calibration.point_2, &stereo_calibration.point_3 };
+
+			instance->s_stereo.area_points.resize(4);
+			for (short i = 0; i < 4; i++) {
+				instance->s_stereo.area_points[i] = cv::Point2f((float)points[i]->x, (float)points[i]->y);
+			}
+
+			instance->s_stereo.homography_matrix = findHomography(instance->s_stereo.area_points, getNormalizedAreaCorners());
+		}
+
+		if (calibration_settings.projection_calibration.valid) {
+
+			BbAreaCalibration projection_calibration_aux = calibration_settings.projection_calibration;
+
+			corners_reset(&instance->s_calibration_state.corners);
+
+			instance->s_calibration_state.area_points.clear();
+			instance->s_calibration_state.area_points.resize(4);
+
+			instance->s_calibration_state.area_points[0].x = (float)projection_calibration_aux.point_0.x;
+			instance->s_calibration_state.area_points[0].y = (float)projection_calibration_aux.point_0.y;
+
+			instance->s_calibration_state.area_points[1].x = (float)projection_calibration_aux.point_1.x;
+			instance->s_calibration_state.area_points[1].y = (float)projection_calibration_aux.point_1.y;
+
+			instance->s_calibration_state.area_points[2].x = (float)projection_calibration_aux.point_2.x;
+			instance->s_calibration_state.area_points[2].y = (float)projection_calibration_aux.point_2.y;
+
+			instance->s_calibration_state.area_points[3].x = (float)projection_calibration_aux.point_3.x;
+			instance->s_calibration_state.area_points[3].y = (float)projection_calibration_aux.point_3.y;
+
+			instance->s_calibration_state.reprojection_error = projection_calibration_aux.reprojection_error;
+			instance->s_calibration_state.inlier_ratio = projection_calibration_aux.inlier_ratio;
+
+			updateHomography(instance);
+
+			instance->s_calibration_state.have_matrix = true;
+		}
+		else {
+			instance->s_calibration_state.have_matrix = false;
+		}
+	}
+
+	instance->s_configuration_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbCoordinator bbCreateCoordinator() {
+
+	BbCoordinator_T * coordinator = new BbCoordinator_T();
+
+	if (coordinator == nullptr) {
+		return nullptr;
+	}
+
+	coordinator_reset(&coordinator->s_coordinator);
+
+	return coordinator;
+}
+
+void bbDestroyCoordinator(BbCoordinator a_coordinator) {
+	BbCoordinator_T* coordinator = castCoordinator(a_coordinator);
+	if (coordinator == nullptr) return;
+
+	for (BbInstance_T * camera : coordinator->s_cameras) {
+		bbDestroyInstance(camera);
+	}
+
+	delete coordinator;
+}
+
+BbInstance bbAddCoordinatorCamera(
+	BbCoordinator a_coordinator,
+	int camera_index,
+	BbWallRegion region) {
+
+	BbCoordinator_T* coordinator = castCoordinator(a_coordinator);
+	if (coordinator == nullptr) return nullptr;
+
+	if (region.size.x <= 0.0 || region.size.y <= 0.0) {
+		return nullptr;
+	}
+
+	coordinator->s_mutex.lock();
+
+	if (coordinator->s_running) {
+		coordinator->s_mutex.unlock();
+		return nullptr;
+	}
+
+	BbInstance_T * camera = castInstance(bbCreateInstance());
+	if (camera == nullptr) {
+		coordinator->s_mutex.unlock();
+		return nullptr;
+	}
+
+	camera->s_camera_index = camera_index;
+	camera->s_coordinator = coordinator;
+	camera->s_coordinator_camera = (int)coordinator->s_cameras.size();
+
+	coordinator->s_cameras.push_back(camera);
+	coordinator->s_coordinator.regions.push_back(region);
+
+	coordinator->s_mutex.unlock();
+
+	return camera;
+}
+
+BbResult bbSetCoordinatorParameters(
+	BbCoordinator a_coordinator,
+	BbCoordinatorParameters parameters) {
+
+	BbCoordinator_T* coordinator = castCoordinator(a_coordinator);
+	if (coordinator == nullptr) return BB_FAILURE;
+
+	coordinator->s_mutex.lock();
+
+	coordinator->s_coordinator.parameters = parameters;
+
+	coordinator->s_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbSetCoordinatorImpactCallback(
+	BbCoordinator a_coordinator,
+	BbImpactCallback callback) {
+
+	BbCoordinator_T* coordinator = castCoordinator(a_coordinator);
+	if (coordinator == nullptr) return BB_FAILURE;
+
+	coordinator->s_mutex.lock();
+
+	coordinator->s_impact_callback = callback;
+
+	coordinator->s_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbLaunchCoordinator(BbCoordinator a_coordinator) {
+
+	BbCoordinator_T* coordinator = castCoordinator(a_coordinator);
+	if (coordinator == nullptr) return BB_FAILURE;
+
+	coordinator->s_mutex.lock();
+
+	if (coordinator->s_running || coordinator->s_cameras.empty()) {
+		coordinator->s_mutex.unlock();
+		return BB_FAILURE;
+	}
+
+	//
+	//	The balls and the impacts of the last launch are long gone
+	//
+	coordinator_reset(&coordinator->s_coordinator);
+	coordinator->s_running = true;
+
+	//
+	//	They are marked as running before their threads start so
+	//	stopping right after launching can't be missed
+	//
+	for (BbInstance_T * camera : coordinator->s_cameras) {
+		camera->s_should_stop = false;
+		camera->s_running = true;
+	}
+
+	coordinator->s_mutex.unlock();
+
+	//
+	//	All of them share the clock so their impacts can be compared
+	//
+	std::chrono::steady_clock::time_point launch_time = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (BbInstance_T * camera : coordinator->s_cameras) {
+		threads.push_back(std::thread(runInstance, camera, launch_time));
+	}
+
+	for (std::thread & thread : threads) {
+		thread.join();
+	}
+
+	coordinator->s_mutex.lock();
+	coordinator->s_running = false;
+	coordinator->s_mutex.unlock();
+
+	return BB_SUCCESS;
+}
+
+BbResult bbStopCoordinator(BbCoordinator a_coordinator) {
+
+	BbCoordinator_T* coordinator = castCoordinator(a_coordinator);
+	if (coordinator == nullptr) return BB_FAILURE;
+
+	for (BbInstance_T * camera : coordinator->s_cameras) {
+		bbStop(camera);
+	}
+
+	return BB_SUCCESS;
+}
+
+
+//
+//  ============================================
+//           DEFINING INTERNAL FUNCTIONS
+//  ============================================
+//
+
+void onMouse(int event, int x, int y, int flags, void* param) {
+	if (event == cv::EVENT_LBUTTONDOWN) {
+		MouseClick* data = (MouseClick*)(param);
+		data->point.x = x;
+		data->point.y = y;
+		data->clicked = true;
+	}
+}
+
+void reorderBallRanges(BbInstance_T* state) {
+
+	if (state->s_ball_detection_parameters.h_low > state->s_ball_detection_parameters.h_high) {
+		int aux = state->s_ball_detection_parameters.h_low;
+		state->s_ball_detection_parameters.h_low = state->s_ball_detection_parameters.h_high;
+		state->s_ball_detection_parameters.h_high = aux;
+	}
+
+	if (state->s_ball_detection_parameters.s_low > state->s_ball_detection_parameters.s_high) {
+		int aux = state->s_ball_detection_parameters.s_low;
+		state->s_ball_detection_parameters.s_low = state->s_ball_detection_parameters.s_high;
+		state->s_ball_detection_parameters.s_high = aux;
+	}
+
+	if (state->s_ball_detection_parameters.v_low > state->s_ball_detection_parameters.v_high) {
+		int aux = state->s_ball_detection_parameters.v_low;
+		state->s_ball_detection_parameters.v_low = state->s_ball_detection_parameters.v_high;
+		state->s_ball_detection_parameters.v_high = aux;
+	}
+
+}
+
+BbResult parseFrame(BbInstance_T* instance) {
+
+	cv::Mat clean_frame, stereo_frame;
+
+	//
+	//	With a second camera we grab both before decoding
+	//	any so their frames are as close in time as they can
+	//
+	StereoState * stereo = &instance->s_stereo;
+	bool use_stereo = stereo->have_matrix && stereo->video->isOpened();
+
+	if (use_stereo) {
+		if (!instance->s_video->grab() || !stereo->video->grab() ||
+			!instance->s_video->retrieve(clean_frame) || !stereo->video->retrieve(stereo_frame)) {
+			manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+			return BB_FAILURE;
+		}
+	}
+	else if (!instance->s_video->read(clean_frame)) {
+		manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+		return BB_FAILURE;
+	}
+
+	//
+	//	Capture time of the frame, the video files give us their own
+	//	clock so replays behave like the real thing
+	//
+	double timestamp;
+	if (instance->s_configuration_parameters.using_video_file) {
+		timestamp = instance->s_video->get(CV_CAP_PROP_POS_MSEC) / 1000.0;
+	}
+	else {
+		timestamp = std::chrono::duration<double>(std::chrono::steady_clock::now() - instance->s_launch_time).count();
+	}
+	instance->s_frame_id++;
+
+	readAudioFile(instance, timestamp);
+
+
+	//
+	//	We resize the frame to avoid tough computations
+	//	and we still have to decide if we need to blur it
+	//	the code is
+	//		blur(frame, frame, Size(2, 2));
+	//	But we won't do it for now
+	//
+	//	for resizing we either use
+	utilscv_resize(&clean_frame, instance->s_configuration_parameters.target_internal_resolution);
+	//	or
+	//utilscv_resizeCloseTo(&clean_frame, state->s_configuration_parameters.target_internal_resolution);
+
+	if (use_stereo) {
+		utilscv_resize(&stereo_frame, instance->s_configuration_parameters.target_internal_resolution);
+	}
+
+
+	//
+	//	The HSV conversion, the thresholding to get only the ball's pixels,
+	//	the erosions and dilations to avoid bumps and stuff and the labeling
+	//	of the blobs all happen strip by strip inside the pipeline, so we never
+	//	have the whole HSV frame or mask in memory. The frame is split in tiles
+	//	that run in parallel in our pool and get stitched back together.
+	//
+	cv::Scalar hsv_low(instance->s_ball_detection_parameters.h_low,
+		instance->s_ball_detection_parameters.s_low,
+		instance->s_ball_detection_parameters.v_low);
+	cv::Scalar hsv_high(instance->s_ball_detection_parameters.h_high,
+		instance->s_ball_detection_parameters.s_high,
+		instance->s_ball_detection_parameters.v_high);
+
+	if (use_stereo) {
+
+		//
+		//	The tiles of both cameras go to the pool at once, so the
+		//	second one doesn't wait for the slowest tile of the first
+		//
+		int thread_count = threadpool_getThreadCount(&instance->s_thread_pool);
+		int tile_count = pipeline_beginFrame(&instance->s_frame_pipeline, clean_frame, hsv_low, hsv_high, thread_count);
+		int stereo_tile_count = pipeline_beginFrame(&stereo->pipeline, stereo_frame, hsv_low, hsv_high, thread_count);
+
+		threadpool_run(&instance->s_thread_pool, tile_count + stereo_tile_count, [instance, stereo, tile_count](int tile_index) {
+			if (tile_index < tile_count) {
+				pipeline_processTile(&instance->s_frame_pipeline, tile_index);
+			}
+			else {
+				pipeline_processTile(&stereo->pipeline, tile_index - tile_count);
+			}
+		});
+
+		pipeline_finishFrame(&instance->s_frame_pipeline, &instance->s_frame_blobs);
+		pipeline_finishFrame(&stereo->pipeline, &stereo->blobs);
+	}
+	else {
+		pipeline_processFrame(
+			&instance->s_frame_pipeline,
+			&instance->s_thread_pool,
+			clean_frame,
+			hsv_low,
+			hsv_high,
+			&instance->s_frame_blobs);
+
+		stereo->blobs.clear();
+	}
+
+
+	//
+	//	We just care about the blobs that can be balls,
+	//	the biggest ones over the radius threshold
+	//
+	int candidates[TRACKPOOL_MAX_CANDIDATES];
+	bool candidate_used[TRACKPOOL_MAX_CANDIDATES];
+	int candidate_count;
+
+	//
+	//	@@SCOPE
+	//	Here we find the blobs that can be balls
+	//
+	{
+
+		candidate_count = trackpool_selectCandidates(
+			instance->s_frame_blobs,
+			(float)instance->s_ball_detection_parameters.radius_threshold,
+			instance->s_contour_parameters.min_fill_percent / 100.0f,
+			candidates);
+
+	}
+
+
+	//
+	//	@@SCOPE
+	//	Here we follow every ball, calculate the collisions and draw everything accordingly
+	//
+	{
+		TrackPool * pool = &instance->s_track_pool;
+
+		//
+		//	The normal of the wall in this frame, cheap enough to do it
+		//	every time instead of tracking changes of the calibration
+		//
+		instance->s_have_wall_normal = false;
+		if (instance->s_tracking_parameters.collision_method == BB_COLLISION_NORMAL_REVERSAL &&
+			instance->s_calibration_state.have_matrix &&
+			!instance->s_calibration_state.homography_matrix.empty()) {
+
+			geometry_findWallNormal(
+				cv::Matx33d(instance->s_calibration_state.homography_matrix),
+				clean_frame.size(),
+				&instance->s_calibration_state.camera_intrinsics,
+				&instance->s_wall_vanishing_point);
+			instance->s_have_wall_normal = true;
+
+			for (ProjectionArea & area : instance->s_calibration_state.projection_areas) {
+				geometry_findWallNormal(
+					cv::Matx33d(area.homography_matrix),
+					clean_frame.size(),
+					&instance->s_calibration_state.camera_intrinsics,
+					&area.wall_vanishing_point);
+			}
+		}
+
+		//
+		//	We move the trackers to the capture time of this frame, if we don't
+		//	see a ball this is our best guess of where it is, and then we match
+		//	the balls with the blobs close to where we expect them
+		//
+		trackpool_predict(pool, &instance->s_tracking_parameters, timestamp, clean_frame.rows);
+
+		trackpool_assign(pool, &instance->s_tracking_parameters,
+			instance->s_frame_blobs, candidates, candidate_count, candidate_used);
+
+		//
+		//	Balls lost right at the wall come back from the other side of where
+		//	we expect them, so before taking the blobs nobody claimed as new
+		//	balls we check if they are the bounce of one of them
+		//
+		matchOccludedBounces(instance, candidates, candidate_count, candidate_used, timestamp, clean_frame.rows);
+
+		//
+		//	And the second camera tells us how far from the wall they are
+		//
+		measureStereo(instance);
+
+		//
+		//	The shadows have to be found before we draw anything on the frame
+		//
+		if (instance->s_tracking_parameters.shadow_detection) {
+			measureShadows(instance, clean_frame);
+		}
+
+		if (instance->s_configuration_parameters.output_frames) {
+			for (const Blob & blob : instance->s_frame_blobs) {
+				cv::rectangle(clean_frame,
+					cv::Point(blob.stats.min_x, blob.stats.min_y),
+					cv::Point(blob.stats.max_x, blob.stats.max_y),
+					cv::Scalar(0, 255, 0));
+			}
+		}
+
+		for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+			if (!pool->active[slot]) {
+				continue;
+			}
+
+			const Blob * blob = (pool->assignment[slot] >= 0 ? &instance->s_frame_blobs[pool->assignment[slot]] : NULL);
+
+			updateTrack(instance, slot, blob, timestamp, clean_frame);
+		}
+
+		//
+		//	The blobs no ball claimed are new balls, as long as we have room
+		//
+		for (int c = 0; c < candidate_count; c++) {
+
+			if (candidate_used[c]) {
+				continue;
+			}
+
+			int slot = trackpool_createTrack(pool);
+			if (slot < 0) {
+				break;
+			}
+
+			updateTrack(instance, slot, &instance->s_frame_blobs[candidates[c]], timestamp, clean_frame);
+		}
+
+		if (instance->s_coordinator != NULL) {
+			publishTracks(instance, timestamp);
+		}
+
+		//
+		//	And we print every line
+		//
+		for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+			if (!pool->active[slot]) {
+				continue;
+			}
+
+			const BallHistory * history = &pool->history[slot];
+
+			for (unsigned int i = 0; i + 1 < history->size; i++) {
+				cv::line(
+					clean_frame,
+					ringbuffer_getPosition(history, i),
+					ringbuffer_getPosition(history, i + 1),
+					cv::Scalar(255, 0, 255));
+			}
+		}
+	}
+
+	//
+	//	We also print here the last collision coordinates
+	//	if we still have remaining frames for that
+	//
+	if (instance->s_frames_remaining_collision > 0 && instance->s_configuration_parameters.show_collisions) {
+		instance->s_frames_remaining_collision--;
+		cv::circle(clean_frame, instance->s_last_collision_coordinates, 10, cv::Scalar(0, 0, 255), -1);
+	}
+
+	//
+	//	We add the lines that define the projection rectangle
+	//	with the perspective
+	//
+	if (instance->s_configuration_parameters.show_collisions
+		&& instance->s_calibration_state.have_matrix
+		&& instance->s_calibration_state.area_points.size() > 0) {
+		cv::line(clean_frame,
+			instance->s_calibration_state.area_points[0],
+			instance->s_calibration_state.area_points[1], cv::Scalar(255, 100, 0), 4);
+		cv::line(clean_frame,
+			instance->s_calibration_state.area_points[1],
+			instance->s_calibration_state.area_points[2], cv::Scalar(255, 100, 0), 4);
+		cv::line(clean_frame,
+			instance->s_calibration_state.area_points[2],
+			instance->s_calibration_state.area_points[3], cv::Scalar(255, 100, 0), 4);
+		cv::line(clean_frame,
+			instance->s_calibration_state.area_points[3],
+			instance->s_calibration_state.area_points[0], cv::Scalar(255, 100, 0), 4);
+
+		for (const ProjectionArea & area : instance->s_calibration_state.projection_areas) {
+			for (short i = 0; i < 4; i++) {
+				cv::line(clean_frame, area.area_points[i], area.area_points[(i + 1) % 4], cv::Scalar(255, 200, 0), 2);
+			}
+		}
+	}
+
+	//
+	//	Finally we can show the frame
+	//
+	if (instance->s_configuration_parameters.output_frames) {
+		imshow("frame", clean_frame);
+
+		if (use_stereo) {
+			imshow("stereo_frame", stereo_frame);
+		}
+	}
+
+	cv::waitKey(1);
+
+	return BB_SUCCESS;
+
+}
+
+bool estimateImpact(
+	BbInstance_T* instance,
+	int slot,
+	cv::Point2f direction,
+	cv::Point2f position,
+	double timestamp,
+	double* impact_time,
+	cv::Point2f* impact_position,
+	unsigned int* samples_after_impact) {
+
+	const TrackPool * pool = &instance->s_track_pool;
+	const BallHistory * history = &pool->history[slot];
+	const BbTrackingParameters * parameters = &instance->s_tracking_parameters;
+
+	*samples_after_impact = 0;
+
+	//
+	//	Only the detections since the last impact belong to the incoming
+	//	trajectory, and we need at least two of them to know where it goes
+	//
+	unsigned int available = std::min(history->size, pool->samples_since_impact[slot]);
+	if (available < 2 || parameters->trajectory_samples < 2) {
+		return false;
+	}
+
+	RingBufferSample newest = ringbuffer_getElementAt(history, 0);
+	cv::Point2f newest_position(newest.x, newest.y);
+	double reference_time = newest.timestamp;
+
+	RingBufferSpan spans[2];
+	int span_count;
+	TrajectorySegment incoming, outgoing;
+
+	//
+	//	The newest detection in the history can be before or after the impact.
+	//	We fit the incoming trajectory without it and if it came back less far
+	//	than the fit says (more than the noise), it was already bouncing back.
+	//
+	if (available >= 3) {
+
+		span_count = ringbuffer_getSpans(history, 1, std::min(available - 1, (unsigned int)parameters->trajectory_samples), spans);
+
+		if (trajectory_fitSegment(spans, span_count, parameters->trajectory_order, reference_time, &incoming)) {
+
+			cv::Point2f predicted = trajectory_evaluate(&incoming, newest.timestamp);
+			float came_back = (predicted - newest_position).dot(direction);
+			float tolerance = std::max(2.0f * parameters->position_noise + 2.0f * incoming.residual, 1.0f);
+
+			if (came_back > tolerance) {
+
+				//
+				//	The outgoing trajectory is the line through the newest
+				//	detection of the history and the current one
+				//
+				float xs[2] = { newest.x, position.x };
+				float ys[2] = { newest.y, position.y };
+				double timestamps[2] = { newest.timestamp, timestamp };
+
+				RingBufferSpan outgoing_span;
+				outgoing_span.x = xs;
+				outgoing_span.y = ys;
+				outgoing_span.radius = NULL;
+				outgoing_span.timestamp = timestamps;
+				outgoing_span.frame_id = NULL;
+				outgoing_span.count = 2;
+
+				trajectory_fitSegment(&outgoing_span, 1, 1, reference_time, &outgoing);
+
+				RingBufferSample before = ringbuffer_getElementAt(history, 1);
+
+				if (trajectory_intersect(&incoming, &outgoing, direction, before.timestamp, newest.timestamp, impact_time, impact_position)) {
+					*samples_after_impact = 1;
+					return true;
+				}
+
+				return false;
+			}
+		}
+	}
+
+	//
+	//	Otherwise the whole history is incoming and the current detection is the
+	//	only one after the impact, so we bounce the incoming velocity off the wall
+	//
+	span_count = ringbuffer_getSpans(history, 0, std::min(available, (unsigned int)parameters->trajectory_samples), spans);
+
+	if (!trajectory_fitSegment(spans, span_count, parameters->trajectory_order, reference_time, &incoming)) {
+		return false;
+	}
+
+	trajectory_reflectSegment(&incoming, direction, parameters->restitution, position, timestamp, reference_time, &outgoing);
+
+	return trajectory_intersect(&incoming, &outgoing, direction, newest.timestamp, timestamp, impact_time, impact_position);
+}
+
+void updateTrack(BbInstance_T* instance, int slot, const Blob* blob, double timestamp, cv::Mat& frame) {
+
+	//
+	//	The future arguments for printing the markers on the ball
+	//
+	cv::Scalar circle_color(255, 255, 0);
+	cv::Scalar centroid_color(255, 0, 0);
+	int circle_thickness = 2;
+
+	TrackPool * pool = &instance->s_track_pool;
+	BallTracker * tracker = &pool->tracker[slot];
+	const BbTrackingParameters * tracking_parameters = &instance->s_tracking_parameters;
+
+	if (blob == NULL) {
+
+		//
+		//	We keep the predicted ball for a few frames so we can go through
+		//	short dropouts, after that the ball is lost and we free its slot
+		//
+		tracker->coasting_frames++;
+
+		//
+		//	A lost ball won't confirm its prediction
+		//
+		if (pool->impact_predicted[slot] &&
+			(tracker->coasting_frames > tracking_parameters->max_coasting_frames ||
+			timestamp > pool->predicted_impact_time[slot] + tracking_parameters->prediction_timeout)) {
+			cancelPredictedImpact(instance, slot);
+		}
+
+		if (tracker->coasting_frames > tracking_parameters->max_coasting_frames) {
+			trackpool_removeTrack(pool, slot);
+		}
+		else if (instance->s_configuration_parameters.show_collisions) {
+			cv::circle(frame, tracker_getPosition(tracker), (int)tracker_getRadius(tracker), circle_color, 1);
+		}
+
+		return;
+	}
+
+	cv::Point2f centroid = blob->centroid;
+	float radius = blob->radius;
+
+	//
+	//	With a rolling shutter the row of the ball tells when it was captured,
+	//	the tracker is already close to it from the prediction of the pool
+	//	and goes back or forward the little it is off
+	//
+	timestamp = tracker_getRowTimestamp(timestamp, centroid.y, frame.rows, tracking_parameters->readout_time);
+	tracker_predict(tracker, tracking_parameters, timestamp);
+
+	//
+	//	With the exposure time we know the blob can be a streak, and then
+	//	the circle around it is too big, but the ball across it is fine
+	//
+	bool use_streak = (tracking_parameters->exposure_time > 0.0f);
+	if (use_streak) {
+		radius = blob->streak_radius;
+	}
+
+	//
+	//	What we know about the impact if there is one in this frame
+	//
+	bool impact_reported = false;
+	double impact_time = 0.0;
+	cv::Point2f impact_position;
+	cv::Point2f approach_direction;
+	float impact_confidence = 1.0f;
+
+	if (pool->occluded_bounce[slot]) {
+
+		//
+		//	We lost the ball at the wall and found it coming back, the impact
+		//	was already inferred while matching it. The more frames we missed
+		//	the less sure we are about it.
+		//
+		if (trackpool_updateCollisionPhase(pool, slot, tracking_parameters, -1, true, timestamp)) {
+
+			impact_reported = true;
+			impact_time = pool->occluded_impact_time[slot];
+			impact_position = pool->occluded_impact_position[slot];
+			approach_direction = pool->occluded_impact_direction[slot];
+			impact_confidence = std::pow(OCCLUDED_IMPACT_CONFIDENCE_DECAY, (float)tracker->coasting_frames);
+
+			pool->samples_since_impact[slot] = 0;
+		}
+	}
+	//
+	//	We detect here if there has been a collision
+	//
+	else if (tracker->initialized && tracker->measurement_count >= MEASUREMENTS_FOR_COLLISION && centroid.x > 0.0f) {
+		//
+		//	The old direction comes from the motion model so a single noisy
+		//	or missing detection doesn't break it
+		//
+		cv::Point2f previous_position = pool->previous_position[slot];
+		cv::Point2f previous_velocity = pool->previous_velocity[slot];
+		cv::Point2f wall_axis = getWallAxis(instance, centroid);
+		float old_direction = previous_velocity.dot(wall_axis);
+		float curr_direction = (centroid - previous_position).dot(wall_axis);
+
+		//
+		//	Movements along the axis smaller than the noise don't
+		//	count as a direction, so jitter can't flip it
+		//
+		int axis_sign = 0;
+		if (std::abs(curr_direction) > tracking_parameters->position_noise) {
+			axis_sign = (curr_direction > 0.0f ? 1 : -1);
+		}
+
+		//
+		//	The side of the wall comes from the calibration, not from the
+		//	motion, since a ball can be first seen going either way. The
+		//	reversal is against that side and none counts until we know it.
+		//
+		if (pool->approach_sign[slot] == 0) {
+			pool->approach_sign[slot] = getWallSide(instance, centroid, wall_axis);
+		}
+
+		bool axis_reversal = (old_direction * curr_direction < 0.0f && axis_sign != 0 && axis_sign == -pool->approach_sign[slot]);
+
+		//
+		//	And the radius tells us if the ball stopped going away from the camera
+		//
+		BbCollisionMethod collision_method = tracking_parameters->collision_method;
+		DepthSegment incoming_depth;
+		DepthTrend depth_trend = DEPTH_TREND_UNKNOWN;
+
+		if (collision_method == BB_COLLISION_DEPTH || collision_method == BB_COLLISION_COMBINED) {
+			depth_trend = checkDepthTrend(instance, slot, radius, timestamp, &incoming_depth);
+		}
+
+		bool depth_reversal = (depth_trend == DEPTH_TREND_REVERSED);
+
+		//
+		//	With a second camera the ball is at the wall when both see it on
+		//	the same point of the area, so the parallax getting back up after
+		//	being that small is the bounce
+		//
+		int stereo_motion = 0;
+		bool stereo_contact = false;
+		if (collision_method == BB_COLLISION_STEREO) {
+
+			float parallax = pool->stereo_parallax[slot];
+			float previous_parallax = pool->previous_stereo_parallax[slot][0];
+
+			if (parallax >= 0.0f && previous_parallax >= 0.0f) {
+				if (parallax < previous_parallax - STEREO_PARALLAX_NOISE) {
+					stereo_motion = 1;
+				}
+				else if (parallax > previous_parallax + STEREO_PARALLAX_NOISE) {
+					stereo_motion = -1;
+				}
+			}
+
+			stereo_contact = (stereo_motion < 0 && previous_parallax <= tracking_parameters->stereo_contact_parallax);
+		}
+
+		//
+		//	We have a collision if
+		//
+		bool collision = false;
+		switch (collision_method) {
+		case BB_COLLISION_X_REVERSAL:
+		case BB_COLLISION_NORMAL_REVERSAL:
+			collision = axis_reversal;
+			break;
+		case BB_COLLISION_DEPTH:
+			collision = depth_reversal;
+			break;
+		case BB_COLLISION_COMBINED:
+			collision = depth_reversal || (axis_reversal && depth_trend != DEPTH_TREND_CONTINUING);
+			break;
+		case BB_COLLISION_STEREO:
+			collision = stereo_contact;
+			break;
+		}
+
+		//
+		//	The shadow meeting the ball is a collision too, right when it
+		//	touches the wall. If it disappeared behind the ball after getting
+		//	close, they met.
+		//
+		bool shadow_contact = false;
+		if (tracking_parameters->shadow_detection && pool->shadow_converging_frames[slot] >= 1) {
+
+			float distance = pool->shadow_distance[slot];
+			float previous_distance = pool->previous_shadow_distance[slot];
+			float contact_distance = radius * SHADOW_CONTACT_RADII;
+
+			shadow_contact =
+				(distance >= 0.0f && distance <= contact_distance) ||
+				(distance < 0.0f && previous_distance >= 0.0f && previous_distance <= 3.0f * contact_distance);
+		}
+
+		collision = collision || shadow_contact;
+
+
+		//
+		//	How the ball moves with respect to the wall for the state machine,
+		//	the depth knows it better when it can tell
+		//
+		int motion = axis_sign * pool->approach_sign[slot];
+		if (collision_method == BB_COLLISION_DEPTH || collision_method == BB_COLLISION_COMBINED) {
+			if (depth_trend == DEPTH_TREND_CONTINUING) {
+				motion = 1;
+			}
+			else if (depth_trend == DEPTH_TREND_REVERSED) {
+				motion = -1;
+			}
+			else if (collision_method == BB_COLLISION_DEPTH) {
+				motion = 0;
+			}
+		}
+		else if (collision_method == BB_COLLISION_STEREO) {
+			motion = stereo_motion;
+		}
+
+		//
+		//	And only the first detection of every bounce is an impact
+		//
+		if (trackpool_updateCollisionPhase(pool, slot, tracking_parameters, motion, collision, timestamp)) {
+
+			impact_reported = true;
+
+			//
+			//	If the trajectories before and after the bounce meet we get the
+			//	time and position of the impact between frames, otherwise we
+			//	fall back to the previous position of the ball
+			//
+			impact_time = pool->previous_timestamp[slot];
+			impact_position = previous_position;
+			unsigned int samples_after_impact = 0;
+
+			if (shadow_contact) {
+
+				//
+				//	The ball is at the wall now, the time comes from where the
+				//	distance to the shadow (going down linearly) got to the
+				//	contact distance, between the previous frame and this one
+				//
+				impact_time = timestamp;
+				impact_position = centroid;
+				approach_direction = cv::Point2f(0.0f, 0.0f);
+
+				float distance = pool->shadow_distance[slot];
+				float previous_distance = pool->previous_shadow_distance[slot];
+				float contact_distance = radius * SHADOW_CONTACT_RADII;
+				if (distance >= 0.0f && previous_distance > contact_distance && previous_distance > distance) {
+					double previous_time = pool->previous_shadow_time[slot];
+					impact_time = previous_time +
+						(timestamp - previous_time) * (previous_distance - contact_distance) / (previous_distance - distance);
+				}
+
+				pool->shadow_converging_frames[slot] = 0;
+			}
+			else if (stereo_contact) {
+
+				//
+				//	The parallax goes down to zero and back up, where the two
+				//	lines meet is the time, and the ball is on its way between
+				//	the two detections around it
+				//
+				approach_direction = cv::Point2f(0.0f, 0.0f);
+
+				double times[3] = {
+					pool->previous_stereo_time[slot][1],
+					pool->previous_stereo_time[slot][0],
+					timestamp };
+				float parallaxes[3] = {
+					pool->previous_stereo_parallax[slot][1],
+					pool->previous_stereo_parallax[slot][0],
+					pool->stereo_parallax[slot] };
+
+				double contact_time;
+				if (parallaxes[0] >= 0.0f &&
+					stereo_findContactTime(times, parallaxes, tracking_parameters->restitution, &contact_time)) {
+
+					impact_time = contact_time;
+
+					double fraction = (contact_time - times[1]) / (timestamp - times[1]);
+					fraction = std::min(std::max(fraction, 0.0), 1.0);
+					impact_position = previous_position + (centroid - previous_position) * (float)fraction;
+				}
+			}
+			else if (depth_reversal) {
+
+				//
+				//	The ball comes towards the wall along its whole 2D velocity
+				//
+				float speed = (float)cv::norm(previous_velocity);
+				approach_direction = (speed > 0.0f ? previous_velocity / speed : cv::Point2f(0.0f, 0.0f));
+
+				estimateDepthImpact(instance, slot, &incoming_depth, radius, timestamp,
+					&impact_time, &impact_position);
+			}
+			else {
+
+				//
+				//	The ball turned around along the axis, towards the side it was going
+				//
+				approach_direction = wall_axis * (old_direction > 0 ? 1.0f : -1.0f);
+
+				estimateImpact(instance, slot, approach_direction, centroid, timestamp,
+					&impact_time, &impact_position, &samples_after_impact);
+			}
+
+			pool->samples_since_impact[slot] = samples_after_impact;
+		}
+	}
+
+	if (impact_reported) {
+
+		//
+		//	Correct for the depth of the ball
+		//
+		impact_position += approach_direction * (radius * RADIUS_LATERAL_MULT);
+
+		//
+		//	So we update the collision coordinates and set up
+		//	the amount of frames we want to show the collision for
+		//
+		instance->s_last_collision_coordinates = impact_position;
+		instance->s_frames_remaining_collision = NUM_FRAMES_SHOW_COLLISION;
+
+		//
+		//	The radius of the ball right at the wall tells us its depth
+		//	for predicting the next impacts
+		//
+		float previous_radius = pool->previous_radius[slot];
+		instance->s_impact_radius = (instance->s_impact_radius > 0.0f ?
+			instance->s_impact_radius + IMPACT_RADIUS_SMOOTHING * (previous_radius - instance->s_impact_radius) :
+			previous_radius);
+
+		BbImpactEvent event;
+		event.type = BB_IMPACT_CONFIRMED;
+		event.impact_id = (pool->impact_predicted[slot] ? pool->predicted_impact_id[slot] : instance->s_impact_count + 1);
+		event.track_id = pool->track_id[slot];
+		event.timestamp = impact_time;
+		event.frame_id = instance->s_frame_id;
+		event.confidence = impact_confidence;
+
+		if (!pool->impact_predicted[slot]) {
+			instance->s_impact_count++;
+		}
+		pool->impact_predicted[slot] = false;
+
+		reportImpact(instance, &event, impact_position);
+
+	}
+
+
+	//
+	//	With the data from the circle and the centroid we can draw it
+	//
+	if (instance->s_configuration_parameters.show_collisions) {
+		cv::circle(frame, blob->center, (int)radius, circle_color, circle_thickness);
+		cv::circle(frame, centroid, 3, centroid_color, -1);
+	}
+
+	//
+	//	We feed the measurement to the tracker (or start tracking)
+	//	and insert the element in the history
+	//
+	if (tracker->initialized && !pool->occluded_bounce[slot]) {
+		tracker_correct(tracker, tracking_parameters, centroid, radius);
+
+		//
+		//	The streak gives us the speed of the ball in this very frame, but
+		//	not its sign, we take the one of the movement since the last frame
+		//	or of the tracker. The frame of a bounce has both directions mixed.
+		//
+		if (use_streak && !impact_reported && tracker->measurement_count >= 2) {
+
+			cv::Point2f direction = blob->streak_direction;
+			float moved = (centroid - pool->previous_position[slot]).dot(direction);
+
+			if (std::abs(moved) <= tracking_parameters->position_noise) {
+				moved = tracker_getVelocity(tracker).dot(direction);
+			}
+
+			float speed = blob->streak_length / tracking_parameters->exposure_time;
+			cv::Point2f velocity = direction * (moved < 0.0f ? -speed : speed);
+
+			tracker_correctVelocity(tracker, velocity,
+				tracking_parameters->streak_noise / tracking_parameters->exposure_time);
+		}
+	}
+	else {
+
+		//
+		//	After an unseen bounce the motion model points the wrong way
+		//	so we start over from here, keeping the ball and its history
+		//
+		tracker_start(tracker, tracking_parameters, centroid, radius, timestamp);
+	}
+
+	ringbuffer_insert(&pool->history[slot], centroid.x, centroid.y, radius, timestamp, instance->s_frame_id);
+	pool->samples_since_impact[slot]++;
+
+	if (pool->shadow_distance[slot] >= 0.0f) {
+		pool->previous_shadow_distance[slot] = pool->shadow_distance[slot];
+		pool->previous_shadow_time[slot] = timestamp;
+	}
+
+	if (pool->stereo_parallax[slot] >= 0.0f) {
+		pool->previous_stereo_parallax[slot][1] = pool->previous_stereo_parallax[slot][0];
+		pool->previous_stereo_time[slot][1] = pool->previous_stereo_time[slot][0];
+		pool->previous_stereo_parallax[slot][0] = pool->stereo_parallax[slot];
+		pool->previous_stereo_time[slot][0] = timestamp;
+	}
+
+	//
+	//	The ball should have bounced by now, the prediction was wrong
+	//
+	if (pool->impact_predicted[slot] &&
+		timestamp > pool->predicted_impact_time[slot] + tracking_parameters->prediction_timeout) {
+		cancelPredictedImpact(instance, slot);
+	}
+
+	//
+	//	Once per throw we try to tell the host about the impact
+	//	before the ball actually bounces
+	//
+	if (tracking_parameters->predict_impacts && !pool->impact_predicted[slot] &&
+		pool->collision_phase[slot] != COLLISION_PHASE_IMPACT &&
+		pool->collision_phase[slot] != COLLISION_PHASE_RECEDING) {
+		predictImpact(instance, slot, timestamp);
+	}
+}
+
+void matchOccludedBounces(
+	BbInstance_T* instance,
+	const int* candidates,
+	int candidate_count,
+	bool* candidate_used,
+	double frame_timestamp,
+	int frame_rows) {
+
+	TrackPool * pool = &instance->s_track_pool;
+	const BbTrackingParameters * parameters = &instance->s_tracking_parameters;
+
+	for (int c = 0; c < candidate_count; c++) {
+
+		if (candidate_used[c]) {
+			continue;
+		}
+
+		const Blob & blob = instance->s_frame_blobs[candidates[c]];
+		double timestamp = tracker_getRowTimestamp(frame_timestamp, blob.centroid.y, frame_rows, parameters->readout_time);
+
+		int best_slot = -1;
+		float best_distance = std::numeric_limits<float>::max();
+		double best_time = 0.0;
+		cv::Point2f best_position, best_direction;
+
+		for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+			//
+			//	Only balls going to the wall that we stopped seeing a
+			//	few frames ago, with enough history to fit their way in
+			//
+			const BallTracker * tracker = &pool->tracker[slot];
+			const BallHistory * history = &pool->history[slot];
+			unsigned int available = std::min(history->size, pool->samples_since_impact[slot]);
+
+			if (!pool->active[slot] || pool->assignment[slot] >= 0 ||
+				pool->collision_phase[slot] != COLLISION_PHASE_APPROACHING ||
+				tracker->coasting_frames < 1 ||
+				tracker->coasting_frames > parameters->max_occluded_impact_frames ||
+				available < 2) {
+				continue;
+			}
+
+			//
+			//	The wall is on the side of the approach along the axis, or if
+			//	we only know it from the depth, along the whole 2D velocity
+			//
+			cv::Point2f predicted = tracker_getPosition(tracker);
+			cv::Point2f direction;
+			if (parameters->collision_method != BB_COLLISION_DEPTH && pool->approach_sign[slot] != 0) {
+				direction = getWallAxis(instance, predicted) * (float)pool->approach_sign[slot];
+			}
+			else {
+				cv::Point2f velocity = tracker_getVelocity(tracker);
+				float speed = (float)cv::norm(velocity);
+				if (speed <= 0.0f) {
+					continue;
+				}
+				direction = velocity / speed;
+			}
+
+			//
+			//	The blob has to be behind the position where the ball would be
+			//	if it kept going, and not too far from it across the wall normal
+			//
+			cv::Point2f offset = blob.centroid - predicted;
+			if (offset.dot(direction) >= 0.0f) {
+				continue;
+			}
+
+			cv::Point2f across(-direction.y, direction.x);
+			cv::Matx21f across_vector(across.x, across.y);
+			cv::Matx22f position_covariance(
+				tracker->covariance(TRACKER_X, TRACKER_X), tracker->covariance(TRACKER_X, TRACKER_Y),
+				tracker->covariance(TRACKER_Y, TRACKER_X), tracker->covariance(TRACKER_Y, TRACKER_Y));
+			float across_variance = (across_vector.t() * position_covariance * across_vector)(0) +
+				parameters->position_noise * parameters->position_noise;
+			float across_distance = offset.dot(across);
+
+			if (across_distance * across_distance > parameters->association_gate * parameters->association_gate * across_variance) {
+				continue;
+			}
+
+			//
+			//	And the way in and the way out (bouncing through the
+			//	blob) have to meet inside the gap
+			//
+			RingBufferSample newest = ringbuffer_getElementAt(history, 0);
+			RingBufferSpan spans[2];
+			int span_count = ringbuffer_getSpans(history, 0, std::min(available, (unsigned int)std::max(parameters->trajectory_samples, 2)), spans);
+
+			TrajectorySegment incoming, outgoing;
+			if (!trajectory_fitSegment(spans, span_count, parameters->trajectory_order, newest.timestamp, &incoming)) {
+				continue;
+			}
+
+			trajectory_reflectSegment(&incoming, direction, parameters->restitution,
+				blob.centroid, timestamp, newest.timestamp, &outgoing);
+
+			double impact_time;
+			cv::Point2f impact_position;
+			if (!trajectory_intersect(&incoming, &outgoing, direction, newest.timestamp, timestamp, &impact_time, &impact_position)) {
+				continue;
+			}
+
+			if (std::abs(across_distance) < best_distance) {
+				best_distance = std::abs(across_distance);
+				best_slot = slot;
+				best_time = impact_time;
+				best_position = impact_position;
+				best_direction = direction;
+			}
+		}
+
+		if (best_slot >= 0) {
+			pool->assignment[best_slot] = candidates[c];
+			pool->occluded_bounce[best_slot] = true;
+			pool->occluded_impact_time[best_slot] = best_time;
+			pool->occluded_impact_position[best_slot] = best_position;
+			pool->occluded_impact_direction[best_slot] = best_direction;
+			candidate_used[c] = true;
+		}
+	}
+}
+
+void measureShadows(BbInstance_T* instance, const cv::Mat& frame) {
+
+	TrackPool * pool = &instance->s_track_pool;
+	const BbBallDetectionParameters * detection = &instance->s_ball_detection_parameters;
+	const BbTrackingParameters * parameters = &instance->s_tracking_parameters;
+
+	cv::Scalar hsv_low(detection->h_low, detection->s_low, detection->v_low);
+	cv::Scalar hsv_high(detection->h_high, detection->s_high, detection->v_high);
+
+	for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+		pool->shadow_distance[slot] = -1.0f;
+
+		if (!pool->active[slot] || pool->assignment[slot] < 0 || pool->occluded_bounce[slot]) {
+			continue;
+		}
+
+		const Blob & blob = instance->s_frame_blobs[pool->assignment[slot]];
+		float radius = (parameters->exposure_time > 0.0f ? blob.streak_radius : blob.radius);
+
+		//
+		//	There is only a projector shadow inside the area
+		//
+		if (!isInsideArea(instance, blob.centroid)) {
+			pool->shadow_converging_frames[slot] = 0;
+			continue;
+		}
+
+		cv::Point2f shadow;
+		if (!shadow_find(&instance->s_shadow_detector, frame, blob.centroid, radius,
+			hsv_low, hsv_high, parameters->shadow_darkness, &shadow)) {
+			continue;
+		}
+
+		float distance = (float)cv::norm(shadow - blob.centroid);
+		float previous_distance = pool->previous_shadow_distance[slot];
+
+		if (previous_distance >= 0.0f && distance < previous_distance - parameters->position_noise) {
+			pool->shadow_converging_frames[slot]++;
+		}
+		else if (previous_distance >= 0.0f && distance > previous_distance + parameters->position_noise) {
+			pool->shadow_converging_frames[slot] = 0;
+		}
+
+		pool->shadow_distance[slot] = distance;
+	}
+}
+
+void measureStereo(BbInstance_T* instance) {
+
+	TrackPool * pool = &instance->s_track_pool;
+	StereoState * stereo = &instance->s_stereo;
+
+	bool use_stereo =
+		instance->s_tracking_parameters.collision_method == BB_COLLISION_STEREO &&
+		instance->s_calibration_state.have_matrix &&
+		stereo->have_matrix &&
+		!stereo->blobs.empty();
+
+	cv::Matx33d homography;
+	if (use_stereo) {
+		homography = cv::Matx33d(stereo->homography_matrix);
+	}
+
+	for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+		pool->stereo_parallax[slot] = -1.0f;
+
+		if (!use_stereo || !pool->active[slot] || pool->assignment[slot] < 0 || pool->occluded_bounce[slot]) {
+			continue;
+		}
+
+		//
+		//	Both cameras map the ball to the area through the wall, so
+		//	how much they disagree grows with its distance to it
+		//
+		const Blob & blob = instance->s_frame_blobs[pool->assignment[slot]];
+		cv::Point2f area_position = mapToArea(instance, blob.centroid);
+		cv::Point2f stereo_position;
+
+		if (stereo_matchBlob(stereo->blobs, (float)instance->s_ball_detection_parameters.radius_threshold,
+			instance->s_contour_parameters.min_fill_percent / 100.0f, homography, area_position, STEREO_MAX_PARALLAX, &stereo_position) >= 0) {
+			pool->stereo_parallax[slot] = (float)cv::norm(stereo_position - area_position);
+		}
+	}
+}
+
+void publishTracks(BbInstance_T* instance, double timestamp) {
+
+	if (!instance->s_calibration_state.have_matrix) {
+		return;
+	}
+
+	TrackPool * pool = &instance->s_track_pool;
+	BbCoordinator_T * coordinator = instance->s_coordinator;
+
+	coordinator->s_mutex.lock();
+
+	for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+		//
+		//	Only the balls we saw, where we guess the lost ones
+		//	are is no good to hand them to another camera
+		//
+		const BallHistory * history = &pool->history[slot];
+		if (!pool->active[slot] || history->size == 0 ||
+			ringbuffer_getElementAt(history, 0).frame_id != instance->s_frame_id) {
+			continue;
+		}
+
+		coordinator_updateTrack(&coordinator->s_coordinator,
+			instance->s_coordinator_camera,
+			pool->track_id[slot],
+			mapToArea(instance, ringbuffer_getPosition(history, 0)),
+			timestamp);
+	}
+
+	coordinator->s_mutex.unlock();
+}
+
+bool isInsideArea(BbInstance_T* instance, cv::Point2f point) {
+
+	if (!instance->s_calibration_state.have_matrix) {
+		return false;
+	}
+
+	cv::Point2f area_point;
+	routeToArea(instance, point, &area_point);
+
+	return area_point.x >= 0.0f && area_point.x <= 1.0f &&
+		area_point.y >= 0.0f && area_point.y <= 1.0f;
+}
+
+DepthTrend checkDepthTrend(
+	BbInstance_T* instance,
+	int slot,
+	float radius,
+	double timestamp,
+	DepthSegment* incoming) {
+
+	const TrackPool * pool = &instance->s_track_pool;
+	const BallHistory * history = &pool->history[slot];
+	const BbTrackingParameters * parameters = &instance->s_tracking_parameters;
+
+	unsigned int available = std::min(history->size, pool->samples_since_impact[slot]);
+	if (available < MEASUREMENTS_FOR_COLLISION) {
+		return DEPTH_TREND_UNKNOWN;
+	}
+
+	RingBufferSpan spans[2];
+	int span_count = ringbuffer_getSpans(history, 0, std::min(available, (unsigned int)std::max(parameters->trajectory_samples, 2)), spans);
+
+	if (!trajectory_fitDepth(spans, span_count, ringbuffer_getElementAt(history, 0).timestamp, incoming)) {
+		return DEPTH_TREND_UNKNOWN;
+	}
+
+	return trajectory_checkDepthTrend(incoming, radius, parameters->radius_noise, timestamp);
+}
+
+bool estimateDepthImpact(
+	BbInstance_T* instance,
+	int slot,
+	const DepthSegment* incoming,
+	float radius,
+	double timestamp,
+	double* impact_time,
+	cv::Point2f* impact_position) {
+
+	const TrackPool * pool = &instance->s_track_pool;
+	const BallHistory * history = &pool->history[slot];
+	const BbTrackingParameters * parameters = &instance->s_tracking_parameters;
+
+	RingBufferSample newest = ringbuffer_getElementAt(history, 0);
+
+	double time;
+	if (!trajectory_intersectDepth(incoming, parameters->restitution, radius, timestamp, newest.timestamp, timestamp, &time)) {
+		return false;
+	}
+
+	//
+	//	The position is where the incoming trajectory was at that time,
+	//	fitted to the same samples as the depth
+	//
+	RingBufferSpan spans[2];
+	int span_count = ringbuffer_getSpans(history, 0, incoming->sample_count, spans);
+
+	TrajectorySegment trajectory;
+	if (!trajectory_fitSegment(spans, span_count, parameters->trajectory_order, newest.timestamp, &trajectory)) {
+		return false;
+	}
+
+	*impact_time = time;
+	*impact_position = trajectory_evaluate(&trajectory, time);
+
+	return true;
+}
+
+void predictImpact(BbInstance_T* instance, int slot, double timestamp) {
+
+	TrackPool * pool = &instance->s_track_pool;
+	const BallHistory * history = &pool->history[slot];
+	const BallTracker * tracker = &pool->tracker[slot];
+	const BbTrackingParameters * parameters = &instance->s_tracking_parameters;
+
+	//
+	//	We need to know where the wall is (from a previous impact)
+	//	and to have followed this throw for a while
+	//
+	unsigned int available = std::min(history->size, pool->samples_since_impact[slot]);
+
+	if (instance->s_impact_radius <= 0.0f ||
+		!instance->s_calibration_state.have_matrix ||
+		tracker->measurement_count < MEASUREMENTS_FOR_COLLISION ||
+		available < MEASUREMENTS_FOR_COLLISION) {
+		return;
+	}
+
+	//
+	//	When the ball reaches the depth of the wall is when it hits it
+	//
+	RingBufferSpan spans[2];
+	int span_count = ringbuffer_getSpans(history, 0, std::min(available, (unsigned int)std::max(parameters->trajectory_samples, 2)), spans);
+
+	DepthSegment depth;
+	double impact_time;
+
+	if (!trajectory_fitDepth(spans, span_count, timestamp, &depth) ||
+		!trajectory_findDepthCrossing(&depth, instance->s_impact_radius, timestamp, &impact_time) ||
+		impact_time - timestamp > parameters->prediction_horizon) {
+		return;
+	}
+
+	//
+	//	And where it will be then is what the motion model says, with the
+	//	uncertainty of the model plus the one of the time of the impact
+	//
+	BallTracker future = *tracker;
+	tracker_predict(&future, parameters, impact_time);
+
+	cv::Point2f impact_position = tracker_getPosition(&future);
+	cv::Point2f impact_velocity = tracker_getVelocity(&future);
+
+	double time_deviation = depth.residual / std::abs(depth.coefficients[1]);
+	double speed = cv::norm(impact_velocity);
+	double variance =
+		future.covariance(TRACKER_X, TRACKER_X) +
+		future.covariance(TRACKER_Y, TRACKER_Y) +
+		speed * speed * time_deviation * time_deviation;
+
+	//
+	//	The confidence is how likely it is that the error is within a
+	//	radius of the ball, for a round gaussian with that total variance
+	//
+	double impact_radius = instance->s_impact_radius;
+	float confidence = (float)(1.0 - std::exp(-impact_radius * impact_radius / std::max(variance, 1e-6)));
+
+	if (confidence < parameters->prediction_min_confidence) {
+		return;
+	}
+
+	//
+	//	Same correction for the depth of the ball as the confirmed impacts,
+	//	along the direction the collision method will confirm it with: the
+	//	axis of the wall for the reversals, the whole 2D velocity for the
+	//	depth and none for the stereo contact
+	//
+	cv::Point2f approach_direction(0.0f, 0.0f);
+
+	switch (parameters->collision_method) {
+	case BB_COLLISION_X_REVERSAL:
+	case BB_COLLISION_NORMAL_REVERSAL:
+		approach_direction = getWallAxis(instance, impact_position) * (float)pool->approach_sign[slot];
+		break;
+	case BB_COLLISION_DEPTH:
+	case BB_COLLISION_COMBINED:
+		approach_direction = (speed > 0.0 ? impact_velocity / (float)speed : cv::Point2f(0.0f, 0.0f));
+		break;
+	case BB_COLLISION_STEREO:
+		break;
+	}
+
+	impact_position += approach_direction * (float)(impact_radius * RADIUS_LATERAL_MULT);
+
+	BbImpactEvent event;
+	event.type = BB_IMPACT_PREDICTED;
+	event.impact_id = instance->s_impact_count + 1;
+	event.track_id = pool->track_id[slot];
+	event.timestamp = impact_time;
+	event.frame_id = instance->s_frame_id;
+	event.confidence = confidence;
+
+	if (reportImpact(instance, &event, impact_position)) {
+		instance->s_impact_count++;
+		pool->impact_predicted[slot] = true;
+		pool->predicted_impact_id[slot] = event.impact_id;
+		pool->predicted_impact_time[slot] = impact_time;
+		pool->predicted_impact_position[slot] = impact_position;
+	}
+}
+
+void cancelPredictedImpact(BbInstance_T* instance, int slot) {
+
+	TrackPool * pool = &instance->s_track_pool;
+
+	if (!pool->impact_predicted[slot]) {
+		return;
+	}
+
+	BbImpactEvent event;
+	event.type = BB_IMPACT_CANCELLED;
+	event.impact_id = pool->predicted_impact_id[slot];
+	event.track_id = pool->track_id[slot];
+	event.timestamp = pool->predicted_impact_time[slot];
+	event.frame_id = instance->s_frame_id;
+	event.confidence = 0.0f;
+
+	pool->impact_predicted[slot] = false;
+
+	reportImpact(instance, &event, pool->predicted_impact_position[slot]);
+}
+
+bool reportImpact(BbInstance_T* instance, BbImpactEvent* event, cv::Point2f frame_position) {
+
+	if (!instance->s_calibration_state.have_matrix) {
+		return false;
+	}
+
+	cv::Point2f area_position;
+	int area = routeToArea(instance, frame_position, &area_position);
+
+	event->x = area_position.x;
+	event->y = area_position.y;
+	event->area_id = (area >= 0 ? instance->s_calibration_state.projection_areas[area].area_id : 0);
+
+	std::shared_ptr<const ZoneIndex> zone_index = std::atomic_load(&instance->s_zone_index);
+	if (zone_index) {
+		event->zone_count = zones_find(zone_index.get(), event->area_id, event->x, event->y, event->zone_ids, BB_MAX_IMPACT_ZONES);
+	}
+
+	//
+	//	The sound of the hit is way more precise than the frames
+	//
+	if (event->type == BB_IMPACT_CONFIRMED) {
+		matchImpactSound(instance, event);
+	}
+
+	//
+	//	A predicted impact only matters if it is going to hit the area
+	//
+	if (event->type == BB_IMPACT_PREDICTED &&
+		(event->x < 0.0f || event->x > 1.0f || event->y < 0.0f || event->y > 1.0f)) {
+		return false;
+	}
+
+	//
+	//	And we use the CALLBACKS if we have to
+	//
+	if (instance->s_should_stop) {
+		return true;
+	}
+
+	//
+	//	As a camera of a coordinator it decides if the host hears about it
+	//
+	if (instance->s_coordinator != NULL) {
+
+		BbCoordinator_T * coordinator = instance->s_coordinator;
+		coordinator->s_mutex.lock();
+
+		if (coordinator_submitImpact(&coordinator->s_coordinator, instance->s_coordinator_camera, event) &&
+			coordinator->s_impact_callback != NULL) {
+			coordinator->s_impact_callback(event);
+		}
+
+		coordinator->s_mutex.unlock();
+
+		return true;
+	}
+
+	if (instance->s_callback_functions.coordinate_callback != NULL && event->type == BB_IMPACT_CONFIRMED) {
+		instance->s_callback_functions.coordinate_callback(event->x, event->y);
+	}
+
+	if (instance->s_callback_functions.impact_callback != NULL) {
+		instance->s_callback_functions.impact_callback(event);
+	}
+
+	return true;
+}
+
+BbAreaCalibration finishAreaCalibration(BbInstance_T* instance) {
+
+	CalibrationState * state = &instance->s_calibration_state;
+	StereoState * stereo = &instance->s_stereo;
+	BbAreaCalibration projection_calibration;
+
+	bool have_corners = (state->corners.count > 0);
+
+	if (!instance->s_is_calibrating_projection && state->have_matrix && state->area_points.size() == 4) {
+		have_corners = true;
+	}
+	else if (!have_corners) {
+
+		manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_CALIBRATE);
+
+		state->average_points.clear();
+		state->area_points.clear();
+		state->homography_matrix = cv::Mat();
+	}
+	else {
+
+		corners_estimate(&state->corners, &state->parameters,
+			&state->area_points, &state->reprojection_error, &state->inlier_ratio);
+		utilscv_sortSquarePoints(&state->area_points);
+
+		updateHomography(instance);
+
+		//
+		//	The second camera gets its own corners the same way
+		//
+		float stereo_error, stereo_inlier_ratio;
+		if (stereo->camera_index >= 0 &&
+			corners_estimate(&stereo->corners, &state->parameters, &stereo->area_points, &stereo_error, &stereo_inlier_ratio)) {
+
+			utilscv_sortSquarePoints(&stereo->area_points);
+
+			stereo->homography_matrix = findHomography(stereo->area_points, getNormalizedAreaCorners());
+			stereo->have_matrix = true;
+		}
+		else if (stereo->camera_index >= 0) {
+			manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_CALIBRATE);
+		}
+	}
+
+	if (have_corners) {
+
+		projection_calibration.point_0.x = state->area_points[0].x;
+		projection_calibration.point_0.y = state->area_points[0].y;
+
+		projection_calibration.point_1.x = state->area_points[1].x;
+		projection_calibration.point_1.y = state->area_points[1].y;
+
+		projection_calibration.point_2.x = state->area_points[2].x;
+		projection_calibration.point_2.y = state->area_points[2].y;
+
+		projection_calibration.point_3.x = state->area_points[3].x;
+		projection_calibration.point_3.y = state->area_points[3].y;
+
+		projection_calibration.reprojection_error = state->reprojection_error;
+		projection_calibration.inlier_ratio = state->inlier_ratio;
+
+		projection_calibration.valid = true;
+	}
+
+	//
+	//	We destroy all windows to get ready for a possible
+	//	next execution, if we opened any
+	//
+	if (instance->s_is_calibrating_projection && state->shown_windows) {
+		cv::destroyAllWindows();
+	}
+	state->shown_windows = false;
+
+	instance->s_video->release();
+	stereo->video->release();
+
+	instance->s_is_calibrating_projection = false;
+
+	state->have_matrix = have_corners;
+
+	return projection_calibration;
+}
 
-		//
-		//	Setting the ball parameters
-		//
-		calibration_settings.ball_detection_parameters = instance->s_ball_detection_parameters;
+void checkAreaCalibration(BbInstance_T* instance) {
+
+	if (!corners_isConverged(&instance->s_calibration_state.corners, &instance->s_calibration_state.parameters)) {
+		return;
 	}
 
-	instance->s_configuration_mutex.unlock();
+	BbAreaCalibration projection_calibration = finishAreaCalibration(instance);
 
-	return calibration_settings;
+	if (instance->s_callback_functions.area_calibration_callback != NULL) {
+		instance->s_callback_functions.area_calibration_callback(&projection_calibration);
+	}
 }
 
-BbResult bbSetCalibrationSettings(BbInstance a_instance, BbCalibrationSettings calibration_settings) {
-
-	BbInstance_T* instance = castInstance(a_instance);
-	if (instance == nullptr) return BB_FAILURE;
+std::vector<cv::Point2f> getNormalizedAreaCorners() {
 
 	std::vector<cv::Point2f> normal_values;
 	normal_values.push_back(cv::Point2f(0.f, 1.f));
@@ -1151,415 +4264,433 @@ BbResult bbSetCalibrationSettings(BbInstance a_instance, BbCalibrationSettings c
 	normal_values.push_back(cv::Point2f(1.f, 0.f));
 	normal_values.push_back(cv::Point2f(0.f, 0.f));
 
-	instance->s_configuration_mutex.lock();
+	return normal_values;
+}
 
-	{
+void updateHomography(BbInstance_T* instance) {
 
-		instance->s_ball_detection_parameters = calibration_settings.ball_detection_parameters;
+	std::vector<cv::Point2f> normal_values = getNormalizedAreaCorners();
 
-		if (calibration_settings.projection_calibration.valid) {
+	CalibrationState * state = &instance->s_calibration_state;
 
-			BbAreaCalibration projection_calibration_aux = calibration_settings.projection_calibration;
+	//
+	//	Just the four corners, so correcting them is free
+	//
+	state->average_points.resize(state->area_points.size());
+	for (size_t i = 0; i < state->area_points.size(); i++) {
+		state->average_points[i] = geometry_undistortPoint(
+			&state->camera_intrinsics,
+			instance->s_configuration_parameters.target_internal_resolution,
+			state->area_points[i]);
+	}
 
-			instance->s_calibration_state.square_points.clear();
+	state->homography_matrix = findHomography(state->average_points, normal_values);
 
-			instance->s_calibration_state.average_points.clear();
-			instance->s_calibration_state.average_points.resize(4);
+	//
+	//	The lens changes the other areas too
+	//
+	for (ProjectionArea & area : state->projection_areas) {
+		updateAreaHomography(instance, &area);
+	}
+}
 
-			instance->s_calibration_state.average_points[0].x = (float)projection_calibration_aux.point_0.x;
-			instance->s_calibration_state.average_points[0].y = (float)projection_calibration_aux.point_0.y;
+void setProjectionAreas(BbInstance_T* instance, const BbProjectionArea* areas, uint32_t area_count) {
 
-			instance->s_calibration_state.average_points[1].x = (float)projection_calibration_aux.point_1.x;
-			instance->s_calibration_state.average_points[1].y = (float)projection_calibration_aux.point_1.y;
+	std::vector<ProjectionArea> & projection_areas = instance->s_calibration_state.projection_areas;
+	projection_areas.clear();
 
-			instance->s_calibration_state.average_points[2].x = (float)projection_calibration_aux.point_2.x;
-			instance->s_calibration_state.average_points[2].y = (float)projection_calibration_aux.point_2.y;
+	for (uint32_t i = 0; i < std::min(area_count, (uint32_t)BB_MAX_PROJECTION_AREAS); i++) {
 
-			instance->s_calibration_state.average_points[3].x = (float)projection_calibration_aux.point_3.x;
-			instance->s_calibration_state.average_points[3].y = (float)projection_calibration_aux.point_3.y;
+		const BbAreaCalibration & calibration = areas[i].calibration;
+		if (!calibration.valid) {
+			continue;
+		}
 
-			instance->s_calibration_state.homography_matrix = findHomography(instance->s_calibration_state.average_points, normal_values);
+		ProjectionArea area;
+		area.area_id = areas[i].area_id;
+		area.area_points.push_back(cv::Point2f((float)calibration.point_0.x, (float)calibration.point_0.y));
+		area.area_points.push_back(cv::Point2f((float)calibration.point_1.x, (float)calibration.point_1.y));
+		area.area_points.push_back(cv::Point2f((float)calibration.point_2.x, (float)calibration.point_2.y));
+		area.area_points.push_back(cv::Point2f((float)calibration.point_3.x, (float)calibration.point_3.y));
 
-			instance->s_calibration_state.have_matrix = true;
-		}
-		else {
-			instance->s_calibration_state.have_matrix = false;
-		}
+		updateAreaHomography(instance, &area);
+
+		projection_areas.push_back(area);
 	}
+}
 
-	instance->s_configuration_mutex.unlock();
+void updateAreaHomography(BbInstance_T* instance, ProjectionArea* area) {
 
-	return BB_SUCCESS;
+	std::vector<cv::Point2f> undistorted_points(area->area_points.size());
+	for (size_t i = 0; i < area->area_points.size(); i++) {
+		undistorted_points[i] = geometry_undistortPoint(
+			&instance->s_calibration_state.camera_intrinsics,
+			instance->s_configuration_parameters.target_internal_resolution,
+			area->area_points[i]);
+	}
+
+	area->homography_matrix = findHomography(undistorted_points, getNormalizedAreaCorners());
 }
 
+cv::Point2f mapToArea(BbInstance_T* instance, cv::Point2f frame_position) {
+	return mapWithHomography(instance, instance->s_calibration_state.homography_matrix, frame_position);
+}
 
-//
-//  ============================================
-//           DEFINING INTERNAL FUNCTIONS
-//  ============================================
-//
+cv::Point2f mapWithHomography(BbInstance_T* instance, const cv::Mat& homography, cv::Point2f frame_position) {
 
-void onMouse(int event, int x, int y, int flags, void* param) {
-	if (event == cv::EVENT_LBUTTONDOWN) {
-		MouseClick* data = (MouseClick*)(param);
-		data->point.x = x;
-		data->point.y = y;
-		data->clicked = true;
-	}
+	//
+	//	Use OpenCV's perspectiveTransform with the previously obtained
+	//	Homography matrix to map screen coordinates to wall projection
+	//	coordinates, once the point is where it would be without the lens.
+	//
+	std::vector<cv::Point2f> input_not_transformed;
+	input_not_transformed.push_back(geometry_undistortPoint(
+		&instance->s_calibration_state.camera_intrinsics,
+		instance->s_configuration_parameters.target_internal_resolution,
+		frame_position));
+	std::vector<cv::Point2f> output_transformed;
+	output_transformed.push_back(cv::Point2f(0, 0));
+	perspectiveTransform(input_not_transformed, output_transformed, homography);
+
+	return output_transformed[0];
 }
 
-void reorderBallRanges(BbInstance_T* state) {
+int routeToArea(BbInstance_T* instance, cv::Point2f frame_position, cv::Point2f* area_position) {
 
-	if (state->s_ball_detection_parameters.h_low > state->s_ball_detection_parameters.h_high) {
-		int aux = state->s_ball_detection_parameters.h_low;
-		state->s_ball_detection_parameters.h_low = state->s_ball_detection_parameters.h_high;
-		state->s_ball_detection_parameters.h_high = aux;
-	}
+	*area_position = mapToArea(instance, frame_position);
 
-	if (state->s_ball_detection_parameters.s_low > state->s_ball_detection_parameters.s_high) {
-		int aux = state->s_ball_detection_parameters.s_low;
-		state->s_ball_detection_parameters.s_low = state->s_ball_detection_parameters.s_high;
-		state->s_ball_detection_parameters.s_high = aux;
+	if ((area_position->x >= 0.0f && area_position->x <= 1.0f &&
+		area_position->y >= 0.0f && area_position->y <= 1.0f)) {
+		return -1;
 	}
 
-	if (state->s_ball_detection_parameters.v_low > state->s_ball_detection_parameters.v_high) {
-		int aux = state->s_ball_detection_parameters.v_low;
-		state->s_ball_detection_parameters.v_low = state->s_ball_detection_parameters.v_high;
-		state->s_ball_detection_parameters.v_high = aux;
-	}
+	const std::vector<ProjectionArea> & areas = instance->s_calibration_state.projection_areas;
 
-}
+	for (int i = 0; i < (int)areas.size(); i++) {
 
-BbResult parseFrame(BbInstance_T* instance) {
+		cv::Point2f position = mapWithHomography(instance, areas[i].homography_matrix, frame_position);
 
-	cv::Mat clean_frame, frame, mask;
+		if (position.x >= 0.0f && position.x <= 1.0f &&
+			position.y >= 0.0f && position.y <= 1.0f) {
+			*area_position = position;
+			return i;
+		}
+	}
 
+	return -1;
+}
 
-	if (!instance->s_video->read(clean_frame)) {
-		manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
-		return BB_FAILURE;
-	}
+cv::Point2f getWallAxis(BbInstance_T* instance, cv::Point2f position) {
 
+	if (!instance->s_have_wall_normal) {
+		return cv::Point2f(1.0f, 0.0f);
+	}
 
 	//
-	//	We resize the frame to avoid tough computations
-	//	and we still have to decide if we need to blur it
-	//	the code is
-	//		blur(frame, frame, Size(2, 2));
-	//	But we won't do it for now
+	//	Every area has its own wall, the one the ball is in front of
 	//
-	//	for resizing we either use
-	utilscv_resize(&clean_frame, instance->s_configuration_parameters.target_internal_resolution);
-	//	or
-	//utilscv_resizeCloseTo(&clean_frame, state->s_configuration_parameters.target_internal_resolution);
+	cv::Point2f area_position;
+	int area = routeToArea(instance, position, &area_position);
+	if (area >= 0) {
+		return geometry_getWallAxis(instance->s_calibration_state.projection_areas[area].wall_vanishing_point, position);
+	}
 
+	return geometry_getWallAxis(instance->s_wall_vanishing_point, position);
+}
+
+int getWallSide(BbInstance_T* instance, cv::Point2f position, cv::Point2f wall_axis) {
+
+	const CalibrationState * state = &instance->s_calibration_state;
+
+	cv::Point2f area_position;
+	int area = routeToArea(instance, position, &area_position);
 
 	//
-	//	Change the frame to HSV color format
+	//	Unless the vanishing point is at infinity, when the camera
+	//	looks along the wall and the axis could go either way
 	//
-	cvtColor(clean_frame, frame, CV_BGR2HSV);
+	if (instance->s_have_wall_normal) {
+		const cv::Vec3d & vanishing_point = (area >= 0 ?
+			state->projection_areas[area].wall_vanishing_point :
+			instance->s_wall_vanishing_point);
+		if (vanishing_point[2] != 0.0) {
+			return 1;
+		}
+	}
+
+	const std::vector<cv::Point2f> & area_points = (area >= 0 ?
+		state->projection_areas[area].area_points :
+		state->area_points);
 
+	if (area_points.empty()) {
+		return 0;
+	}
+
+	cv::Point2f center(0.0f, 0.0f);
+	for (const cv::Point2f & point : area_points) {
+		center += point;
+	}
+	center *= 1.0f / area_points.size();
 
 	//
-	//	And we get our frame with only the ball's pixels, we do some
-	//	erosions and dilations to avout bumps and stuff
+	//	A ball right in front of the middle could be on either side
 	//
-	cv::inRange(frame,
-		cv::Scalar(instance->s_ball_detection_parameters.h_low,
-			instance->s_ball_detection_parameters.s_low,
-			instance->s_ball_detection_parameters.v_low),
-		cv::Scalar(instance->s_ball_detection_parameters.h_high,
-			instance->s_ball_detection_parameters.s_high,
-			instance->s_ball_detection_parameters.v_high),
-		mask);
+	float offset = (center - position).dot(wall_axis);
+	if (std::abs(offset) <= instance->s_tracking_parameters.position_noise) {
+		return 0;
+	}
 
-	cv::erode(mask, mask, cv::Mat(), cv::Point(-1, -1), 2, 1, 1);
-	cv::dilate(mask, mask, cv::Mat(), cv::Point(-1, -1), 2, 1, 1);
+	return (offset > 0.0f ? 1 : -1);
+}
+
+bool findAreaCorners(const cv::Mat& mask, std::vector<cv::Point2f>* corners) {
 
+	std::vector<std::vector<cv::Point>> contours;
+	std::vector<cv::Vec4i> hierarchy;
 
 	//
-	//	We just care about the radius and the centre
-	//	so we can open a new scope
+	//	findContours modifies the mask in this version of OpenCV
 	//
-	cv::Point2f center, centroid(-1.f, -1.f);
-	float radius = 0.0f;
-	bool found_circle = false;
+	cv::Mat contour_mask = mask.clone();
+	cv::findContours(contour_mask, contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
 
 	//
-	//	@@SCOPE
-	//	Here we find the properties of the circle that encloses the ball
+	//	The biggest 4 sided polygon, like in the calibration of the first camera
 	//
-	{
+	float largest_area = 0.0f;
+	corners->clear();
 
-#ifdef HOUGH
+	for (const std::vector<cv::Point> & contour : contours) {
 
-		std::vector<cv::Vec3f> circles;
-
-		cv::Mat hough_frame = mask;
+		std::vector<cv::Point> polygon;
+		cv::approxPolyDP(cv::Mat(contour), polygon, 3, true);
 
+		if (polygon.size() != 4) {
+			continue;
+		}
 
-		cv::erode(hough_frame, hough_frame, cv::Mat(), cv::Point(-1, -1), 6, 1, 1);
-		cv::dilate(hough_frame, hough_frame, cv::Mat(), cv::Point(-1, -1), 6, 1, 1);
-		cv::GaussianBlur(hough_frame, hough_frame, cv::Size(9, 9), 2, 2);
+		float area = static_cast<float>(cv::contourArea(polygon, false));
+		if (area > largest_area) {
+			largest_area = area;
+			corners->assign(polygon.begin(), polygon.end());
+		}
+	}
 
+	if (corners->size() != 4) {
+		return false;
+	}
 
-		imshow("test blurred", hough_frame);
-		cv::waitKey(10);
+	utilscv_sortSquarePoints(corners);
 
-		cv::HoughCircles(hough_frame, circles, CV_HOUGH_GRADIENT, 1, mask.rows / 8, 100, 20, 0, 0);
+	return true;
+}
 
-		for (size_t i = 0; i < circles.size(); i++)
-		{
-			//float radius_aux = cvRound(circles[i][2]);
+void calibrateStereoArea(BbInstance_T* instance, const cv::Scalar& hsv_low, const cv::Scalar& hsv_high, bool show_frames) {
 
-			float radius_aux = circles[i][2];
+	StereoState * stereo = &instance->s_stereo;
+	if (stereo->camera_index < 0 || !stereo->video->isOpened()) {
+		return;
+	}
 
-			//
-			//	We could probably remove this check since cv::HoughCircles is likely already doing it.
-			//
-			if (radius_aux > instance->s_ball_detection_parameters.radius_threshold) {
-				cv::Point center_aux(cvRound(circles[i][0]), cvRound(circles[i][1]));
-				radius = radius_aux;
-				centroid = center_aux;
-				found_circle = true;
-			}
+	cv::Mat clean_frame, frame, mask;
 
+	for (short i = 0; i < CALIBRATION_WARMUP; i++) {
+		if (!stereo->video->read(clean_frame)) {
+			manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+			return;
 		}
+	}
 
-#else	//We default to the contours method
+	utilscv_resize(&clean_frame, instance->s_configuration_parameters.target_internal_resolution);
+	cv::cvtColor(clean_frame, frame, CV_BGR2HSV);
+	cv::inRange(frame, hsv_low, hsv_high, mask);
 
+	std::vector<cv::Point2f> corners;
+	if (findAreaCorners(mask, &corners)) {
+		corners_add(&stereo->corners, corners, &instance->s_calibration_state.parameters);
+	}
 
-		//
-		//	Output Vectors for the contours
-		//
-		std::vector< std::vector<cv::Point> > contours;
-		std::vector<cv::Vec4i> hierarchy;
+	if (show_frames && instance->s_configuration_parameters.output_frames) {
+		cv::imshow("stereo_mask", mask);
+		cv::waitKey(1);
+	}
+}
+
+bool getCalibrationFrame(BbInstance_T* instance, const BbFrame* host_frame, int settle_frames, cv::Mat* frame) {
+
+	if (host_frame != nullptr) {
+
+		if (host_frame->pixels == nullptr || host_frame->width <= 0 || host_frame->height <= 0 ||
+			host_frame->stride < host_frame->width * 3) {
+			manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+			return false;
+		}
 
 		//
-		//	We look for the external contours
+		//	We copy it, the pixels are the host's and the resizing would write on them
 		//
-		cv::findContours(mask, contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+		*frame = cv::Mat(host_frame->height, host_frame->width, CV_8UC3,
+			(void*)host_frame->pixels, (size_t)host_frame->stride).clone();
 
-		std::vector<std::vector<cv::Point>> approx_contours;
+		return true;
+	}
 
-		if (contours.size() > 0) {
+	if (!openCalibrationCamera(instance)) {
+		return false;
+	}
 
-			approx_contours.resize(contours.size());
+	//
+	//	A warmup like the click calibrations, without the windows
+	//
+	for (int i = 0; i < settle_frames; i++) {
+		if (!instance->s_video->read(*frame)) {
+			manageError(instance->s_callback_functions.error_callback, BbError::COULD_NOT_READ_FRAME);
+			return false;
+		}
+	}
 
-			//
-			//	And we take the biggest one, here we can decide to detect as
-			//	many balls as needed calculating the N biggest contours
-			//
-			float largest_area = 0.0f;
-			int largest_contour_index = -1;
-			for (int i = 0; i < contours.size(); i++) {
-				float epsilon = (float)instance->s_contour_parameters.epsilon_multiplier / EPSILON_DIV * (float)arcLength(contours[i], true);
-				approxPolyDP(contours[i], approx_contours[i], epsilon, true);
-				float area = (float)contourArea(contours[i], false);
+	return true;
+}
 
-				if (area > largest_area && approx_contours[i].size() > instance->s_contour_parameters.circle_contour_limit) {
-					largest_area = area;
-					largest_contour_index = i;
-				}
+bool openCalibrationCamera(BbInstance_T* instance) {
 
-			}
+	if (!instance->s_video->isOpened() && !instance->s_video->open(instance->s_camera_index)) {
+		manageError(instance->s_callback_functions.error_callback, BbError::UNABLE_TO_OPEN_VIDEO);
+		return false;
+	}
 
-			if (instance->s_configuration_parameters.output_frames) {
-				drawContours(clean_frame, approx_contours, -1, cv::Scalar(0, 255, 0));
-			}
+	return true;
+}
 
+bool sampleHSV(const cv::Mat& frame, cv::Point point, cv::Vec3b* hsv) {
 
-			if (largest_contour_index >= 0) {
-				//
-				//	And we take the minimum enclosing circle for our contour
-				//	to be able to calculate its centroid
-				//
-				cv::minEnclosingCircle(contours[largest_contour_index], center, radius);
-				cv::Moments moments = cv::moments(contours[largest_contour_index]);
-				centroid = cv::Point2f((float)moments.m10 / (float)moments.m00, (float)moments.m01 / (float)moments.m00);
+	if (!cv::Rect(0, 0, frame.cols, frame.rows).contains(point)) {
+		return false;
+	}
 
-				if (radius > instance->s_ball_detection_parameters.radius_threshold) {
-					found_circle = true;
-				}
-			}
+	cv::Mat HSV;
+	cv::cvtColor(frame(cv::Rect(point.x, point.y, 1, 1)), HSV, CV_BGR2HSV);
+	*hsv = HSV.at<cv::Vec3b>(0, 0);
 
-		}
+	return true;
+}
 
-#endif
+bool calibrateAreaFrame(BbInstance_T* instance, cv::Mat frame, const cv::Scalar& hsv_low, const cv::Scalar& hsv_high) {
 
-	}
+	cv::Mat hsv_frame, mask;
 
+	utilscv_resize(&frame, instance->s_configuration_parameters.target_internal_resolution);
+	cv::cvtColor(frame, hsv_frame, CV_BGR2HSV);
+	cv::inRange(hsv_frame, hsv_low, hsv_high, mask);
 
-	//
-	//	@@SCOPE
-	//	Here we calculate the collisions and draw everything accordingly
-	//
-	{
-		//
-		//	The future arguments for printing the markers on the ball
-		//
-		cv::Scalar circle_color(255, 255, 0);
-		cv::Scalar centroid_color(255, 0, 0);
-		int circle_thickness = 2;
+	std::vector<cv::Point2f> corners;
+	if (!findAreaCorners(mask, &corners)) {
+		return false;
+	}
 
-		//
-		//	We detect here if there has been a collision
-		//
-		if (found_circle && instance->s_main_deque.size > DEQUE_SIZE_FOR_COLLISION && centroid.x > 0.0f) {
-			//
-			//	For the old direction we can calculate the average of the last N frames
-			//
-			float old_direction = deque_getElementAt(&instance->s_main_deque, 1).x - deque_getElementAt(&instance->s_main_deque, 1 + COLLISION_PAST_STEPS).x;
-			float curr_direction = centroid.x - deque_getElementAt(&instance->s_main_deque, 1).x;
+	corners_add(&instance->s_calibration_state.corners, corners, &instance->s_calibration_state.parameters);
 
+	return true;
+}
 
-			//
-			//	We have a collision if
-			//
-			if (old_direction * curr_direction < 0.0f) {
+void setBallRanges(
+	BbInstance_T* instance,
+	cv::Vec3b hsv_dark,
+	cv::Vec3b hsv_lit,
+	int hue_threshold,
+	int saturation_threshold,
+	int value_threshold) {
 
-				//
-				//	So we update the collision coordinates and set up
-				//	the amount of frames we want to show the collision for
-				//
-				instance->s_last_collision_coordinates = deque_getElementAt(&instance->s_main_deque, 1);
+	instance->s_ball_detection_parameters.h_low = hsv_dark[0];
+	instance->s_ball_detection_parameters.s_low = hsv_dark[1];
+	instance->s_ball_detection_parameters.v_low = hsv_dark[2];
 
-				//
-				//	Correct for the depth of the ball
-				//
-				if (old_direction > 0) {
-					instance->s_last_collision_coordinates.x += radius * RADIUS_LATERAL_MULT;
-				}
-				else {
-					instance->s_last_collision_coordinates.x -= radius * RADIUS_LATERAL_MULT;
-				}
+	instance->s_ball_detection_parameters.h_high = hsv_lit[0];
+	instance->s_ball_detection_parameters.s_high = hsv_lit[1];
+	instance->s_ball_detection_parameters.v_high = hsv_lit[2];
 
-				instance->s_frames_remaining_collision = NUM_FRAMES_SHOW_COLLISION;
+	reorderBallRanges(instance);
 
+	instance->s_ball_detection_parameters.h_low -= hue_threshold;
+	instance->s_ball_detection_parameters.s_low -= saturation_threshold;
+	instance->s_ball_detection_parameters.v_low -= value_threshold;
 
-				if (instance->s_calibration_state.have_matrix) {
-					//
-					//	Use OpenCV's findHomography and perspectiveTransform with
-					//	the previously obtained Homography matrix to map screen coordinates
-					//	to wall projection coordinates.
-					//	
-					std::vector<cv::Point2f> input_not_transformed;
-					input_not_transformed.push_back(instance->s_last_collision_coordinates);
-					std::vector<cv::Point2f> output_transformed;
-					output_transformed.push_back(cv::Point2f(0, 0));
-					perspectiveTransform(input_not_transformed, output_transformed, instance->s_calibration_state.homography_matrix);
+	instance->s_ball_detection_parameters.h_high += hue_threshold;
+	instance->s_ball_detection_parameters.s_high += saturation_threshold;
+	instance->s_ball_detection_parameters.v_high += value_threshold;
 
-					//
-					//	And we use the CALLBACK if we have to
-					//
-					if (instance->s_callback_functions.coordinate_callback != NULL && !instance->s_should_stop) {
+	//
+	//	The hues past the ends of the circle go around it
+	//
+	BbBallDetectionParameters * detection = &instance->s_ball_detection_parameters;
+	if (detection->h_high - detection->h_low >= 179) {
+		detection->h_low = 0;
+		detection->h_high = 179;
+	}
+	else {
+		if (detection->h_low < 0) detection->h_low += 180;
+		if (detection->h_high > 179) detection->h_high -= 180;
+	}
 
-						auto collision_transformed = output_transformed[0];
+	//
+	//	@@DOING: Setting saturation and value to broad ranges
+	//
+	instance->s_ball_detection_parameters.s_low = 100;
+	instance->s_ball_detection_parameters.s_high = 255;
+	instance->s_ball_detection_parameters.v_low = 30;
+	instance->s_ball_detection_parameters.v_high = 255;
+}
 
-						instance->s_callback_functions.coordinate_callback(
-							collision_transformed.x,
-							collision_transformed.y
-						);
-					}
-				}
+void readAudioFile(BbInstance_T* instance, double timestamp) {
 
-			}
-		}
+	instance->s_audio_mutex.lock();
 
+	AudioOnsetDetector* detector = &instance->s_audio_detector;
+
+	if (!instance->s_audio_file_samples.empty()) {
 
 		//
-		//	With the data from the circle and the centroid we can draw it
+		//	A bit past the frame, the impacts are interpolated
+		//	between frames and can be after its capture time
 		//
-		if (found_circle && radius > instance->s_ball_detection_parameters.radius_threshold) {
-
-			if (instance->s_configuration_parameters.show_collisions) {
-				cv::circle(clean_frame, center, (int)radius, circle_color, circle_thickness);
-				cv::circle(clean_frame, centroid, 3, centroid_color, -1);
-			}
-
-			//
-			//	We insert the element in the deque
-			//
-			deque_insertElement(&instance->s_main_deque, centroid);
-			instance->s_had_ball_previous_frame = true;
-		}
-		else {
+		double end_time = timestamp + instance->s_audio_parameters.match_window + instance->s_audio_parameters.latency;
+		size_t end = (size_t)std::max(0.0, end_time * detector->sample_rate);
+		end = std::min(end, instance->s_audio_file_samples.size());
 
-			//
-			//	@@DOING: Give a bit more leniance to detect the ball if
-			//	we loose it for a few frames.
-			//
-
-			if (instance->s_had_ball_previous_frame == true) {
-				instance->s_lost_ball_for_frames = NUM_FRAMES_LOST_BALL;
-			}
-			else if (instance->s_lost_ball_for_frames > 0) {
-				--instance->s_lost_ball_for_frames;
-			}
-			else {
-				instance->s_lost_ball_for_frames = -1;
-				deque_init(&instance->s_main_deque);
-			}
+		if (end > instance->s_audio_file_position) {
 
-			instance->s_had_ball_previous_frame = false;
+			double start_time = (double)instance->s_audio_file_position / detector->sample_rate -
+				instance->s_audio_parameters.latency;
 
+			audio_process(
+				detector,
+				instance->s_audio_file_samples.data() + instance->s_audio_file_position,
+				end - instance->s_audio_file_position,
+				start_time);
 
+			instance->s_audio_file_position = end;
 		}
 	}
 
-	//
-	//	And we print every line
-	//
-	if (instance->s_main_deque.size > 0)
-		for (unsigned int i = 0; i < instance->s_main_deque.size - 1; i++) {
-			cv::line(
-				clean_frame,
-				deque_getElementAt(&instance->s_main_deque, i),
-				deque_getElementAt(&instance->s_main_deque, i + 1),
-				cv::Scalar(255, 0, 255));
-		}
-
-	//
-	//	We also print here the last collision coordinates
-	//	if we still have remaining frames for that
-	//
-	if (instance->s_frames_remaining_collision > 0 && instance->s_configuration_parameters.show_collisions) {
-		instance->s_frames_remaining_collision--;
-		cv::circle(clean_frame, instance->s_last_collision_coordinates, 10, cv::Scalar(0, 0, 255), -1);
-	}
+	instance->s_audio_mutex.unlock();
+}
 
-	//
-	//	We add the lines that define the projection rectangle
-	//	with the perspective
-	//
-	if (instance->s_configuration_parameters.show_collisions
-		&& instance->s_calibration_state.have_matrix
-		&& instance->s_calibration_state.average_points.size() > 0) {
-		cv::line(clean_frame,
-			instance->s_calibration_state.average_points[0],
-			instance->s_calibration_state.average_points[1], cv::Scalar(255, 100, 0), 4);
-		cv::line(clean_frame,
-			instance->s_calibration_state.average_points[1],
-			instance->s_calibration_state.average_points[2], cv::Scalar(255, 100, 0), 4);
-		cv::line(clean_frame,
-			instance->s_calibration_state.average_points[2],
-			instance->s_calibration_state.average_points[3], cv::Scalar(255, 100, 0), 4);
-		cv::line(clean_frame,
-			instance->s_calibration_state.average_points[3],
-			instance->s_calibration_state.average_points[0], cv::Scalar(255, 100, 0), 4);
-	}
+void matchImpactSound(BbInstance_T* instance, BbImpactEvent* event) {
 
-	//
-	//	Finally we can show the frame
-	//
-	if (instance->s_configuration_parameters.output_frames) {
-		imshow("frame", clean_frame);
-	}
+	instance->s_audio_mutex.lock();
 
-	cv::waitKey(1);
+	double onset_time;
+	if (audio_takeOnset(
+		&instance->s_audio_detector,
+		event->timestamp,
+		instance->s_audio_parameters.match_window,
+		&onset_time)) {
 
-	return BB_SUCCESS;
+		event->timestamp = onset_time;
+		event->timestamp_source = BB_TIMESTAMP_AUDIO;
+	}
 
+	instance->s_audio_mutex.unlock();
 }
 
 void showUsage() {
@@ -9,7 +9,7 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 #include <cstdint>
 
 #define BB_MAKE_VERSION(major, minor, patch) (((major) << 22) | ((minor) << 12) | (patch))
-#define BB_VERSION BB_MAKE_VERSION(1,0,0)
+#define BB_VERSION BB_MAKE_VERSION(1,1,0)
 
 #define BB_VERSION_MAJOR(version) ((uint32_t)(version) >> 22)
 #define BB_VERSION_MINOR(version) (((uint32_t)(version) >> 12) & 0x3ff)
@@ -20,6 +20,10 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 
 #define BB_DEFINE_HANDLE(object) typedef struct object##_T* object
 
+#define BB_MAX_ZONE_VERTICES 16
+#define BB_MAX_IMPACT_ZONES 8
+#define BB_MAX_PROJECTION_AREAS 8
+
 	enum BbResult {
 		BB_SUCCESS = 0,
 		BB_FAILURE = -1,
@@ -33,7 +37,37 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 		COULD_NOT_CALIBRATE
 	};
 
+	enum BbImpactType {
+		BB_IMPACT_CONFIRMED = 0,
+		BB_IMPACT_PREDICTED = 1,
+		BB_IMPACT_CANCELLED = 2
+	};
+
+	enum BbCollisionMethod {
+		BB_COLLISION_X_REVERSAL = 0,
+		BB_COLLISION_DEPTH = 1,
+		BB_COLLISION_COMBINED = 2,
+		BB_COLLISION_NORMAL_REVERSAL = 3,
+		BB_COLLISION_STEREO = 4
+	};
+
+	enum BbTimestampSource {
+		BB_TIMESTAMP_VISION = 0,
+		BB_TIMESTAMP_AUDIO = 1
+	};
+
+	enum BbCornerAggregation {
+		BB_CORNERS_MEAN = 0,
+		BB_CORNERS_MEDIAN = 1
+	};
+
+	enum BbZoneShape {
+		BB_ZONE_CIRCLE = 0,
+		BB_ZONE_POLYGON = 1
+	};
+
 	BB_DEFINE_HANDLE(BbInstance);
+	BB_DEFINE_HANDLE(BbCoordinator);
 
 	/**
 	Type of the callback function that will be called when a collision of the ball
@@ -55,24 +89,282 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 	typedef int(__stdcall *BbErrorCallback)(int);
 
 
+	struct BbImpactEvent {
+
+		//
+		//	Whether the ball has been seen bouncing back (confirmed) or we
+		//	only expect it to hit the area soon (predicted). A prediction that
+		//	won't be confirmed, because the ball was lost or didn't bounce in
+		//	time, is cancelled with an event of its id and time.
+		//
+		BbImpactType type = BB_IMPACT_CONFIRMED;
+
+		//
+		//	Identifies the impact, the confirmation or cancellation of
+		//	a predicted impact comes with the same id as the prediction
+		//
+		uint32_t impact_id = 0;
+
+		//
+		//	Identifies the ball that hit the area, every ball we
+		//	follow gets a new id when we start seeing it
+		//
+		uint32_t track_id = 0;
+
+		//
+		//	Normalized coordinates (from 0 to 1) of the impact in the area
+		//
+		float x = 0;
+		float y = 0;
+
+		//
+		//	Capture time of the impact in seconds since the processing was
+		//	launched (or position in the video file). It is interpolated
+		//	between frames so it is not a multiple of the frame time.
+		//
+		double timestamp = 0;
+
+		//
+		//	Id of the frame in which the impact was detected
+		//
+		uint32_t frame_id = 0;
+
+		//
+		//	From 0 to 1, how likely it is that the ball hits within a radius
+		//	of the predicted point. Confirmed impacts have a confidence of 1
+		//	and cancelled ones of 0.
+		//
+		float confidence = 1.0f;
+
+		//
+		//	Where the timestamp comes from, the frames (VISION) or the
+		//	sound of the hit matched with it (AUDIO) when audio is set
+		//
+		BbTimestampSource timestamp_source = BB_TIMESTAMP_VISION;
+
+		//
+		//	Ids of the hit zones containing the impact, in the order the
+		//	zones were given, up to BB_MAX_IMPACT_ZONES of them
+		//
+		uint32_t zone_count = 0;
+		uint32_t zone_ids[BB_MAX_IMPACT_ZONES] = { 0 };
+
+		//
+		//	Camera of the BbCoordinator that saw the impact, in the order
+		//	they were added, and always 0 for a single BbInstance. With a
+		//	coordinator the coordinates and ids are for the whole wall.
+		//
+		uint32_t camera_id = 0;
+
+		//
+		//	Id of the projection area the impact is in, with the coordinates
+		//	normalized to it. Impacts outside of every area are in the main
+		//	one (id 0) with coordinates out of the 0 to 1 range.
+		//
+		uint32_t area_id = 0;
+
+	};
+
+	/**
+	Type of the callback function that will be called when a collision of the ball
+	against the area is detected, with all the information we have about it.
+
+	@param Pointer to the BbImpactEvent describing the impact, only valid during the call
+	@return Any integer value used to indicate status, currently unused.
+	@see BbImpactEvent
+	*/
+	typedef int(__stdcall *BbImpactCallback)(const BbImpactEvent*);
+
+
 	struct BbPoint2d {
 		double x = 0;
 		double y = 0;
 	};
 
+	struct BbFrame {
+
+		//
+		//	Image the host got from the camera itself, with 8 bit BGR pixels
+		//	(as OpenCV keeps them) and stride bytes from the start of a row
+		//	to the next one. The library only reads it during the call.
+		//
+		const uint8_t* pixels = nullptr;
+		int32_t width = 0;
+		int32_t height = 0;
+		int32_t stride = 0;
+	};
+
+	struct BbHitZone {
+
+		//
+		//	Reported in the impacts that fall inside the zone
+		//
+		uint32_t zone_id = 0;
+
+		//
+		//	Projection area the zone is in, 0 for the main one
+		//
+		uint32_t area_id = 0;
+
+		BbZoneShape shape = BB_ZONE_CIRCLE;
+
+		//
+		//	Circle, in normalized coordinates of the area (so it is
+		//	stretched like the area is)
+		//
+		BbPoint2d center;
+		double radius = 0;
+
+		//
+		//	Polygon in normalized coordinates of the area, it can
+		//	be concave but not have holes
+		//
+		uint32_t vertex_count = 0;
+		BbPoint2d vertices[BB_MAX_ZONE_VERTICES];
+	};
+
+	struct BbWallRegion {
+
+		//
+		//	Rectangle of the whole wall, in its normalized coordinates (from
+		//	0 to 1), covered by the area calibrated for one of the cameras of
+		//	a BbCoordinator. The regions of the cameras can overlap.
+		//
+		BbPoint2d origin;
+		BbPoint2d size;
+	};
+
+	struct BbCoordinatorParameters {
+
+		//
+		//	Impacts reported by different cameras closer than this, in
+		//	normalized coordinates of the wall, and in seconds, are the
+		//	same hit and only the first one gets to the host
+		//
+		float duplicate_radius = 0.05f;
+		float duplicate_window = 0.1f;
+
+		//
+		//	A ball a camera starts following keeps the id of the one another
+		//	camera saw closer than this, in normalized coordinates of the
+		//	wall, and not longer ago, in seconds
+		//
+		float handoff_radius = 0.15f;
+		float handoff_window = 0.3f;
+
+	};
+
 	struct BbAreaCalibration {
 		BbPoint2d point_0;
 		BbPoint2d point_1;
 		BbPoint2d point_2;
 		BbPoint2d point_3;
 		bool valid = false;
+
+		//
+		//	Quality of the calibration: root mean square distance, in pixels,
+		//	from the corners of the detections used to the corners found, and
+		//	the fraction of the detections used (the rest were outliers)
+		//
+		float reprojection_error = 0;
+		float inlier_ratio = 0;
+	};
+
+	/**
+	Type of the callback function that will be called when the area calibration
+	finishes by itself because the corners of the area are not moving anymore.
+
+	@param Pointer to the corners of the calibrated area, only valid during the call
+	@return Any integer value used to indicate status, currently unused.
+	@see BbAreaCalibrationParameters
+	*/
+	typedef int(__stdcall *BbAreaCalibrationCallback)(const BbAreaCalibration*);
+
+	struct BbAreaCalibrationParameters {
+
+		//
+		//	Detections of the area to take before leaving out the wrong
+		//	ones and before checking if the calibration can finish
+		//
+		uint32_t min_frames = 5;
+
+		//
+		//	Detections with a corner further than this, in pixels, from
+		//	where the others put it are left out
+		//
+		float outlier_distance = 8.0f;
+
+		//
+		//	The calibration finishes by itself once the standard deviation
+		//	of every corner, in pixels, is below the first value for the
+		//	second amount of frames in a row. 0 frames to always wait for
+		//	bbEndAreaCalibration.
+		//
+		float convergence_deviation = 1.0f;
+		uint32_t convergence_frames = 10;
+
+		//
+		//	How the detections are joined when the calibration ends:
+		//		MEAN: the mean of every corner of all of them
+		//		MEDIAN: the median of every corner of the last ones, and then
+		//			the mean of the detections with all their corners closer
+		//			than outlier_distance to it, so people walking in front of
+		//			the projector or wrong contours don't move the area
+		//
+		BbCornerAggregation aggregation = BB_CORNERS_MEDIAN;
+
+	};
+
+	struct BbProjectionArea {
+
+		//
+		//	Reported in the impacts inside the area, 0 is the main area
+		//	so the others should use any other id
+		//
+		uint32_t area_id = 0;
+
+		//
+		//	Corners of the area in the frame, as bbEndAreaCalibration returns them
+		//
+		BbAreaCalibration calibration;
+	};
+
+	struct BbCameraIntrinsics {
+
+		//
+		//	Focal lengths and principal point, in pixels, of frames
+		//	of the size the camera was calibrated with
+		//
+		double fx = 0;
+		double fy = 0;
+		double cx = 0;
+		double cy = 0;
+
+		//
+		//	Distortion coefficients of the lens: radial k1, k2,
+		//	tangential p1, p2 and radial k3
+		//
+		double distortion[5] = { 0, 0, 0, 0, 0 };
+
+		int image_width = 0;
+		int image_height = 0;
+
+		//
+		//	Root mean square distance, in pixels, between the corners
+		//	of the patterns and where the calibration puts them
+		//
+		double reprojection_error = 0;
+
+		bool valid = false;
 	};
 
 	struct BbBallDetectionParameters {
 
 		//
 		//	Variables Storing HSV ranges for the
-		//	ball detection. Defaults are for the tennis ball
+		//	ball detection. Defaults are for the tennis ball.
+		//	A h_low bigger than h_high is the range that goes
+		//	around the hue circle through 0, for reddish balls.
 		//
 		int h_low = 23;
 		int h_high = 43;
@@ -91,9 +383,181 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 
 	};
 
+	struct BbBallColorCalibration {
+
+		//
+		//	Fractions of the pixels of the ball and of the background inside
+		//	the ranges bbCalibrateBallAutomatically found, the first should be
+		//	close to 1 and the second close to 0
+		//
+		float ball_coverage = 0;
+		float background_coverage = 0;
+
+		bool valid = false;
+	};
+
+	struct BbTrackingParameters {
+
+		//
+		//	Standard deviation of the jerk (change of acceleration per second)
+		//	the ball tracker expects, in pixels per second cubed. Higher values
+		//	follow sudden changes faster but smooth less.
+		//
+		float process_noise = 2000.0f;
+
+		//
+		//	Standard deviation of the random walk of the radius of the
+		//	ball, in pixels per square root of a second
+		//
+		float radius_process_noise = 20.0f;
+
+		//
+		//	Standard deviation of the error of the measured position
+		//	and radius of the ball, in pixels
+		//
+		float position_noise = 2.0f;
+		float radius_noise = 1.5f;
+
+		//
+		//	Amount of frames we keep predicting the position of the ball
+		//	when we stop seeing it before we consider it lost
+		//
+		int max_coasting_frames = 7;
+
+		//
+		//	How far a detection can be from where we expect a ball, in
+		//	standard deviations, to be considered the same ball
+		//
+		float association_gate = 4.0f;
+
+		//
+		//	Time the shutter of the camera is open for every frame, in
+		//	seconds. When set, the length of the motion blur streak of the
+		//	ball gives the tracker its speed in every frame. 0 disables it.
+		//
+		float exposure_time = 0.0f;
+
+		//
+		//	Standard deviation of the error of the measured length of
+		//	the motion blur streak, in pixels
+		//
+		float streak_noise = 2.0f;
+
+		//
+		//	Time a rolling shutter camera takes to read a frame from its top
+		//	row to its bottom one, in seconds. When set, every detection gets
+		//	the capture time of its row instead of the one of the frame, that
+		//	is taken as the capture time of the middle row. 0 disables it.
+		//
+		float readout_time = 0.0f;
+
+		//
+		//	Order of the polynomials (1 linear, 2 quadratic) fitted to the
+		//	trajectory before and after an impact and maximum amount of
+		//	detections used to fit the incoming one
+		//
+		int trajectory_order = 2;
+		int trajectory_samples = 6;
+
+		//
+		//	Fraction of the speed towards the wall the ball keeps after
+		//	bouncing, used when we have a single detection after the impact
+		//
+		float restitution = 0.6f;
+
+		//
+		//	How we tell the ball hit the wall:
+		//		X_REVERSAL: the ball turns around along the x axis of the image
+		//		DEPTH: the apparent radius stops shrinking and grows, with the
+		//			camera facing the wall, so the ball came back towards it
+		//		COMBINED: either of them, but x reversals are ignored while the
+		//			radius says the ball is still going towards the wall
+		//		NORMAL_REVERSAL: the ball turns around along the normal of the
+		//			wall as seen in the image, that comes from the calibration of
+		//			the area so the camera can be anywhere but right in front of it
+		//		STEREO: with a second camera (see bbSetStereoCamera) the ball
+		//			turns around right at the wall, where both cameras see it
+		//			on the same point of the area
+		//
+		BbCollisionMethod collision_method = BB_COLLISION_X_REVERSAL;
+
+		//
+		//	Minimum time, in seconds, between two impacts of the same ball
+		//	and frames in a row a ball has to keep a direction (towards or
+		//	away from the wall) before we believe it changed
+		//
+		float min_impact_interval = 0.15f;
+		int direction_hysteresis_frames = 2;
+
+		//
+		//	The ball often disappears right at the wall. If we see it again
+		//	after at most this amount of frames coming back, we infer the
+		//	impact from the trajectories before and after the gap.
+		//
+		int max_occluded_impact_frames = 3;
+
+		//
+		//	With two cameras, how much they can disagree about where the ball
+		//	is in the area (in normalized coordinates) when it turns around
+		//	for it to be at the wall. The further from it the more they do,
+		//	so bounces on the floor in front of the wall are not impacts.
+		//
+		float stereo_contact_parallax = 0.03f;
+
+		//
+		//	Under a projector the ball casts a shadow on the wall that meets
+		//	the ball right when it hits. When enabled we look for it around
+		//	the balls inside the area, as pixels darker than this fraction
+		//	of the brightness around them, and report the impact when they
+		//	meet, before the ball turns around.
+		//
+		bool shadow_detection = false;
+		float shadow_darkness = 0.6f;
+
+		//
+		//	Enables the predicted impact events. They are sent (once per
+		//	throw) when the ball is expected to hit the area in less than
+		//	the horizon, in seconds, with at least the given confidence.
+		//	They are cancelled if the bounce isn't seen within the timeout,
+		//	in seconds, after the predicted time.
+		//
+		bool predict_impacts = false;
+		float prediction_horizon = 0.3f;
+		float prediction_min_confidence = 0.6f;
+		float prediction_timeout = 0.2f;
+
+	};
+
+	struct BbAudioParameters {
+
+		//
+		//	How many times over the background noise the energy of the
+		//	sound has to jump to be considered the sound of a hit
+		//
+		float onset_threshold = 8.0f;
+
+		//
+		//	Maximum time, in seconds, between the impact we see and the
+		//	sound we hear for them to be considered the same hit
+		//
+		float match_window = 0.05f;
+
+		//
+		//	Delay, in seconds, from the hit to the samples getting to us
+		//	(the sound travelling to the microphone and the audio buffers)
+		//	that is taken away from the time of the sounds
+		//
+		float latency = 0.0f;
+
+	};
+
 	struct BbCalibrationSettings {
 		BbAreaCalibration projection_calibration;
 		BbBallDetectionParameters ball_detection_parameters;
+		BbCameraIntrinsics camera_intrinsics;
+		BbAreaCalibration stereo_projection_calibration;
+		uint32_t projection_area_count = 0;
+		BbProjectionArea projection_areas[BB_MAX_PROJECTION_AREAS];
 	};
 
 	/**
@@ -189,6 +653,122 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 		bool show_trackbars,
 		bool output_frames);
 
+	/**
+	Adds a second camera looking at the same area from another place, or
+	removes it. Both cameras are calibrated together with the bbCalibrateArea*
+	functions and read together while processing, and with BB_COLLISION_STEREO
+	the impacts are the bounces where both see the ball on the same point.
+
+	@param the BbInstance that will use both cameras
+	@param index of the second camera for the video source, -1 to use just one
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbSetStereoCamera(
+		BbInstance instance,
+		int camera_index);
+
+	/**
+	Sets the parameters of the motion model used to track the ball
+
+	@param the BbInstance that will hold the configuration parameters
+	@param BbTrackingParameters structure with the parameters to use
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	@see BbTrackingParameters
+	*/
+	IMAGE_DLL_API BbResult bbSetTrackingParameters(
+		BbInstance instance,
+		BbTrackingParameters tracking_parameters);
+
+	/**
+	Returns the parameters of the motion model used to track the ball
+
+	@param the BbInstance that holds the configuration parameters
+	@return BbTrackingParameters structure with the current parameters
+	@see BbTrackingParameters
+	*/
+	IMAGE_DLL_API BbTrackingParameters bbGetTrackingParameters(
+		BbInstance instance);
+
+	/**
+	Sets the parameters used to match the sound of the hits with the impacts
+
+	@param the BbInstance that will hold the configuration parameters
+	@param BbAudioParameters structure with the parameters to use
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	@see BbAudioParameters
+	*/
+	IMAGE_DLL_API BbResult bbSetAudioParameters(
+		BbInstance instance,
+		BbAudioParameters audio_parameters);
+
+	/**
+	Feeds mono 16 bit PCM samples from a microphone. The last sample is
+	considered captured right now, minus the latency in the BbAudioParameters.
+	When the sound of a hit is found close to a confirmed impact the timestamp
+	of the impact is taken from it. It can be called from any thread while
+	processing, and without it (or bbSetAudioFile) only the frames are used.
+	It fails while the frames come from a video file, the samples can't be
+	placed on its clock, so replays need bbSetAudioFile.
+
+	@param the BbInstance that will process the samples
+	@param pointer to the samples
+	@param amount of samples
+	@param sample rate of the samples in Hz
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbPushAudioSamples(
+		BbInstance instance,
+		const int16_t* samples,
+		uint32_t sample_count,
+		uint32_t sample_rate);
+
+	/**
+	Uses a PCM 16 bit WAV file as the sound of the hits instead of a microphone,
+	to test and replay recordings. Its start is aligned with the start of the
+	processing (or of the video file) and it is read along with the frames.
+
+	@param the BbInstance that will process the file
+	@param path to the WAV file, NULL to stop using it
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbSetAudioFile(
+		BbInstance instance,
+		const char* path);
+
+	/**
+	Sets the zones (targets) that the impacts are checked against, the ids of
+	the zones hit come in the BbImpactEvent. The new set replaces the old one
+	at once and can be changed while processing without stopping it.
+
+	@param the BbInstance that will check the impacts
+	@param pointer to the zones, it is copied so it can be freed after the call
+	@param amount of zones, 0 to remove all of them
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	@see BbHitZone
+	*/
+	IMAGE_DLL_API BbResult bbSetHitZones(
+		BbInstance instance,
+		const BbHitZone* zones,
+		uint32_t zone_count);
+
+	/**
+	Sets the projection areas seen by the camera besides the main one (calibrated
+	with bbEndAreaCalibration). Every impact goes to the first area containing
+	it, the main one first, with its coordinates normalized to that area. Each
+	of them can be calibrated with bbStartAreaCalibration and bbEndAreaCalibration
+	before calibrating the main one, keeping the corners returned.
+
+	@param the BbInstance that will route the impacts
+	@param pointer to the areas, it is copied so it can be freed after the call
+	@param amount of areas, up to BB_MAX_PROJECTION_AREAS and 0 to only use the main one
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	@see BbProjectionArea
+	*/
+	IMAGE_DLL_API BbResult bbSetProjectionAreas(
+		BbInstance instance,
+		const BbProjectionArea* areas,
+		uint32_t area_count);
+
 	/**
 	Sets the callback that will be called when we detect a ball collision.
 
@@ -201,6 +781,23 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 		BbInstance instance,
 		BbCoordinateCallback callback_function_ptr);
 
+	/**
+	Sets the callback that will be called with the full information
+	of every ball collision we detect. It is called right after the
+	BbCoordinateCallback if both are set. If predicted impacts are enabled
+	in the BbTrackingParameters it is also called with them, before the
+	ball actually bounces, and with the cancellation of the ones that
+	are never confirmed.
+
+	@param the BbInstance that will call the impact function
+	@param the Callback function to be called with the impact data
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	@see BbImpactCallback
+	*/
+	IMAGE_DLL_API BbResult bbSetImpactCallback(
+		BbInstance instance,
+		BbImpactCallback callback_function_ptr);
+
 	/**
 	Sets the callback that will be called when we detect an error.
 
@@ -223,9 +820,35 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 	IMAGE_DLL_API BbResult bbStartAreaCalibration(
 		BbInstance instance);
 
+	/**
+	Sets when the detections of the area are left out and when the area
+	calibration finishes by itself, without calling bbEndAreaCalibration
+
+	@param the BbInstance that we want to calibrate
+	@param the BbAreaCalibrationParameters with the new values
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbSetAreaCalibrationParameters(
+		BbInstance instance,
+		BbAreaCalibrationParameters parameters);
+
+	/**
+	Sets the callback that will be called when the area calibration finishes by
+	itself. It is called from the bbCalibrateArea* function that finished it,
+	and the calls to them after that fail as we are not calibrating anymore.
+
+	@param the BbInstance that we want to calibrate
+	@param the callback with the format int(__stdcall *BbAreaCalibrationCallback)(const BbAreaCalibration*)
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbSetAreaCalibrationCallback(
+		BbInstance instance,
+		BbAreaCalibrationCallback callback_function_ptr);
+
 	/**
 	Ends the area calibration period, should be called after the
-	bbCalibrateArea* functions
+	bbCalibrateArea* functions. After the calibration finished by itself
+	it returns the same corners again.
 
 	@param the BbInstance that we want to calibrate
 	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
@@ -269,6 +892,70 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 		int a_low_s, int a_high_s,
 		int a_low_v, int a_high_v);
 
+	/**
+	Starts the calibration of the area with patterns shown by the projector
+	instead of the colour of the area, so the light of the room or colourful
+	things around it don't matter. The host shows every pattern (they can be
+	drawn with bbGetCalibrationPattern) full screen on the projector and calls
+	bbShowingCalibrationPattern once it is on, in any order, and then
+	bbEndPatternCalibration. It is an area calibration like the ones
+	started with bbStartAreaCalibration.
+
+	@param the BbInstance that we want to calibrate
+	@param width of the image of the projector in pixels
+	@param height of the image of the projector in pixels
+	@param output amount of patterns to show, can be NULL
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbStartPatternCalibration(
+		BbInstance instance,
+		int projector_width,
+		int projector_height,
+		int* pattern_count);
+
+	/**
+	Draws one of the calibration patterns, black and white stripes (a Gray
+	code) to show full screen on the projector
+
+	@param the BbInstance being calibrated with patterns
+	@param index of the pattern, from 0 to the amount bbStartPatternCalibration gave
+	@param 8 bit grayscale image of the size of the projector to draw the pattern in
+	@param bytes from the start of a row of the image to the next one
+	@return BbResult indicating success (BB_SUCCESS) or BB_FAILURE if there is no such pattern
+	*/
+	IMAGE_DLL_API BbResult bbGetCalibrationPattern(
+		BbInstance instance,
+		int pattern_index,
+		uint8_t* pixels,
+		int stride);
+
+	/**
+	Tells the library that the projector is showing one of the calibration
+	patterns, so it takes the frame of the camera (and of the second camera,
+	if any) with it. It drops the frames the camera had captured before.
+
+	@param the BbInstance being calibrated with patterns
+	@param index of the pattern being shown
+	@param frame with the pattern, NULL to read it from the camera
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbShowingCalibrationPattern(
+		BbInstance instance,
+		int pattern_index,
+		const BbFrame* frame);
+
+	/**
+	Ends the calibration with patterns, decoding them to find where the image
+	of the projector is in the frame and its corners with sub-pixel accuracy.
+	The reprojection error is the distance, in pixels of the frame, from the
+	decoded points to where the homography puts them.
+
+	@param the BbInstance being calibrated with patterns
+	@return The corners of the area, not valid if a pattern is missing or couldn't be decoded
+	*/
+	IMAGE_DLL_API BbAreaCalibration bbEndPatternCalibration(
+		BbInstance instance);
+
 	/**
 	Calibrates the ball that will be thrown by clicking on it in
 	its darkest and lightest colors in two popup windows. It will use the
@@ -286,6 +973,128 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 		int saturation_threshold,
 		int value_threshold);
 
+	/**
+	Calibrates the area like bbCalibrateAreaWithClick but with the point the user
+	would click passed in, so it can run without any window (kiosks, services or
+	hosts with their own interface). The point is in pixels of the frame, as the
+	camera captures it or as the host sends it. Like the other bbCalibrateArea*
+	functions it adds one detection, between bbStartAreaCalibration and
+	bbEndAreaCalibration.
+
+	@param the BbInstance that we want to calibrate
+	@param frame where to look for the area, NULL to read it from the camera
+	@param horizontal position of a pixel of the area
+	@param vertical position of a pixel of the area
+	@param threshold value for the hue of the area
+	@param threshold value for the saturation of the area
+	@param threshold value for the value of the area
+	@return BbResult indicating success (BB_SUCCESS) or BB_FAILURE if the frame couldn't be read or the point is out of it
+	*/
+	IMAGE_DLL_API BbResult bbCalibrateAreaAtPoint(
+		BbInstance instance,
+		const BbFrame* frame,
+		int x,
+		int y,
+		int hue_threshold,
+		int saturation_threshold,
+		int value_threshold);
+
+	/**
+	Calibrates the ball like bbCalibrateBallWithClick but with the points the
+	user would click passed in, both in the same frame, so it can run without
+	any window. The points are in pixels of the frame, as the camera captures
+	it or as the host sends it.
+
+	@param the BbInstance that we want to calibrate
+	@param frame where the ball is, NULL to read it from the camera
+	@param horizontal position of a pixel of the dark side of the ball
+	@param vertical position of a pixel of the dark side of the ball
+	@param horizontal position of a pixel of the lit side of the ball
+	@param vertical position of a pixel of the lit side of the ball
+	@param threshold value for the hue of the ball
+	@param threshold value for the saturation of the ball
+	@param threshold value for the value of the ball
+	@return BbResult indicating success (BB_SUCCESS) or BB_FAILURE if the frame couldn't be read or a point is out of it
+	*/
+	IMAGE_DLL_API BbResult bbCalibrateBallAtPoints(
+		BbInstance instance,
+		const BbFrame* frame,
+		int dark_x,
+		int dark_y,
+		int lit_x,
+		int lit_y,
+		int hue_threshold,
+		int saturation_threshold,
+		int value_threshold);
+
+	/**
+	Calibrates the ball without any click while the operator holds or rolls it
+	in front of the camera, with nothing else moving. The moving pixels are taken
+	as the ball and the still ones as the background, and the HSV ranges of the
+	ball are the ones that cover most of the ball and least of the background,
+	going around the hue circle if the ball is reddish. Blocks for the duration.
+
+	@param the BbInstance that we want to calibrate
+	@param seconds to watch the ball for, a couple of them are enough
+	@param output quality of the ranges found, can be NULL
+	@return BbResult indicating success (BB_SUCCESS) or BB_FAILURE if the frames couldn't be read or the ball couldn't be told apart
+	*/
+	IMAGE_DLL_API BbResult bbCalibrateBallAutomatically(
+		BbInstance instance,
+		float duration,
+		BbBallColorCalibration* calibration);
+
+	/**
+	Starts the calibration of the lens of the camera, should be called
+	before bbCalibrateIntrinsicsWithChessboard
+
+	@param the BbInstance that we want to calibrate
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbStartIntrinsicsCalibration(
+		BbInstance instance);
+
+	/**
+	Looks for a chessboard in the current frame and keeps its corners as a
+	view for the calibration of the lens. The chessboard can be printed or
+	shown by the projector, and every view should show it in a different
+	place and angle, the corners of the frame matter the most.
+
+	@param the BbInstance that we want to calibrate
+	@param amount of inner corners in every row of the chessboard
+	@param amount of inner corners in every column of the chessboard
+	@return BbResult indicating success (BB_SUCCESS) or BB_FAILURE if the chessboard was not found
+	*/
+	IMAGE_DLL_API BbResult bbCalibrateIntrinsicsWithChessboard(
+		BbInstance instance,
+		int inner_columns,
+		int inner_rows);
+
+	/**
+	Ends the calibration of the lens, calculating the intrinsics from the
+	views taken so far. From then on the positions of the balls and of
+	the corners of the area are corrected for the distortion of the lens.
+
+	@param the BbInstance that we want to calibrate
+	@return BbCameraIntrinsics structure with the calibration, not valid if it failed
+	@see BbCameraIntrinsics
+	*/
+	IMAGE_DLL_API BbCameraIntrinsics bbEndIntrinsicsCalibration(
+		BbInstance instance);
+
+	/**
+	Sets the intrinsics of the camera from a previous calibration, an
+	invalid BbCameraIntrinsics disables the correction of the lens
+
+	@param the BbInstance that we want to set the intrinsics of
+	@param BbCameraIntrinsics structure with the intrinsics to use
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	@see BbCameraIntrinsics
+	*/
+	IMAGE_DLL_API BbResult bbSetCameraIntrinsics(
+		BbInstance instance,
+		BbCameraIntrinsics camera_intrinsics);
+
 	/**
 	Returns the structure with the current calibration settings so it can
 	be stored and loaded with the bbSetCalibrationSettings function in the 
@@ -307,5 +1116,85 @@ Including <cstdint> to hold the type uint32_t used for the version of this file
 	*/
 	IMAGE_DLL_API BbResult bbSetCalibrationSettings(BbInstance instance, BbCalibrationSettings calibration_settings);
 
+
+	/**
+	Creates a coordinator to cover a wall with several cameras, every one of
+	them calibrated to its own region of the wall. The balls keep their ids
+	from one camera to another and the impacts come in one stream without the
+	duplicates of the regions that overlap.
+
+	@return A valid BbCoordinator without cameras
+	@see bbAddCoordinatorCamera
+	*/
+	IMAGE_DLL_API BbCoordinator bbCreateCoordinator();
+
+	/**
+	Destroys a coordinator and the instances of all its cameras,
+	it has to be stopped first
+
+	@param A valid BbCoordinator to be destroyed
+	*/
+	IMAGE_DLL_API void bbDestroyCoordinator(BbCoordinator coordinator);
+
+	/**
+	Adds a camera to the coordinator. It returns the instance that processes it,
+	owned by the coordinator, to configure and calibrate it as usual (it has to
+	be calibrated to its region of the wall). Its impacts go to the callback of
+	the coordinator and not to its own callbacks, and its hit zones are in its
+	own area. As the cameras run at the same time, only one of them should
+	output the frames.
+
+	@param the BbCoordinator the camera will be part of
+	@param the index of the camera for the video source
+	@param the region of the wall covered by the area calibrated for the camera
+	@return A valid BbInstance that has NOT been initialized, or NULL if the
+	coordinator is running or the region is empty
+	*/
+	IMAGE_DLL_API BbInstance bbAddCoordinatorCamera(
+		BbCoordinator coordinator,
+		int camera_index,
+		BbWallRegion region);
+
+	/**
+	Sets how the coordinator tells the impacts and the balls of different cameras are the same
+
+	@param the BbCoordinator that will hold the parameters
+	@param the BbCoordinatorParameters with the new values
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbSetCoordinatorParameters(
+		BbCoordinator coordinator,
+		BbCoordinatorParameters parameters);
+
+	/**
+	Sets the callback that will be called with the impacts of all the cameras,
+	in normalized coordinates of the whole wall and once per hit. It is called
+	from the processing threads of the cameras, but never from two at once.
+
+	@param the BbCoordinator that will use the callback
+	@param the callback with the format int(__stdcall *BbImpactCallback)(const BbImpactEvent*)
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbSetCoordinatorImpactCallback(
+		BbCoordinator coordinator,
+		BbImpactCallback callback);
+
+	/**
+	Launches the processing of all the cameras at once, each in its own
+	thread and with the same clock, until bbStopCoordinator is called
+
+	@param the BbCoordinator that will launch the image processing
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbLaunchCoordinator(BbCoordinator coordinator);
+
+	/**
+	Stops the processing of all the cameras of the coordinator
+
+	@param the BbCoordinator that will stop processing the images
+	@return BbResult indicating success (BB_SUCCESS) or an error with its code from the enum BbResult
+	*/
+	IMAGE_DLL_API BbResult bbStopCoordinator(BbCoordinator coordinator);
+
 }
 #endif
\ No newline at end of file
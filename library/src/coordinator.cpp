@@ -0,0 +1,345 @@
+#include "coordinator.h"
+#include <algorithm>
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in coordinator.h, the details are commented here.
+//
+
+//
+//	Record of a ball of a camera, -1 if we don't know it
+//
+static int findTrack(const ImpactCoordinator * coordinator, int camera, uint32_t local_id) {
+
+	for (int i = 0; i < COORDINATOR_MAX_TRACKS; i++) {
+		const CoordinatorTrack & track = coordinator->tracks[i];
+		if (track.used && track.camera == camera && track.local_id == local_id) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+//
+//	Whether a camera is following a ball with that id right now, so
+//	it can't be the one another of its balls comes from
+//
+static bool isClaimed(const ImpactCoordinator * coordinator, int camera, uint32_t global_id, double time) {
+
+	for (int i = 0; i < COORDINATOR_MAX_TRACKS; i++) {
+		const CoordinatorTrack & track = coordinator->tracks[i];
+		if (track.used && track.camera == camera && track.global_id == global_id &&
+			std::abs(time - track.time) <= coordinator->parameters.handoff_window) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//
+//	The oldest records go first, they belong to balls long gone
+//
+static void addTrack(
+	ImpactCoordinator * coordinator,
+	int camera,
+	uint32_t local_id,
+	uint32_t global_id,
+	cv::Point2f position,
+	double time) {
+
+	CoordinatorTrack & track = coordinator->tracks[coordinator->next_track];
+	track.used = true;
+	track.camera = camera;
+	track.local_id = local_id;
+	track.global_id = global_id;
+	track.position = position;
+	track.time = time;
+
+	coordinator->next_track = (coordinator->next_track + 1) % COORDINATOR_MAX_TRACKS;
+}
+
+static void rememberImpact(
+	ImpactCoordinator * coordinator,
+	const BbImpactEvent * event,
+	int camera,
+	uint32_t local_id,
+	cv::Point2f position) {
+
+	CoordinatorImpact & impact = coordinator->impacts[coordinator->next_impact];
+	impact.type = event->type;
+	impact.camera = camera;
+	impact.area_id = event->area_id;
+	impact.local_id = local_id;
+	impact.global_id = event->impact_id;
+	impact.track_id = event->track_id;
+	impact.position = position;
+	impact.time = event->timestamp;
+	impact.confirmed = (event->type == BB_IMPACT_CONFIRMED);
+
+	coordinator->next_impact = (coordinator->next_impact + 1) % COORDINATOR_MAX_IMPACTS;
+}
+
+//
+//	A cancelled prediction takes the id we gave it, and the host only hears
+//	about it once no other camera still expects the same impact
+//
+static bool cancelImpact(ImpactCoordinator * coordinator, int camera, BbImpactEvent * event) {
+
+	CoordinatorImpact * prediction = NULL;
+
+	for (int i = 0; i < COORDINATOR_MAX_IMPACTS; i++) {
+		CoordinatorImpact & impact = coordinator->impacts[i];
+		if (impact.camera == camera && impact.type == BB_IMPACT_PREDICTED && !impact.confirmed &&
+			impact.local_id == event->impact_id) {
+			prediction = &impact;
+		}
+	}
+
+	if (prediction == NULL) {
+		return false;
+	}
+
+	prediction->confirmed = true;
+
+	for (int i = 0; i < COORDINATOR_MAX_IMPACTS; i++) {
+		const CoordinatorImpact & impact = coordinator->impacts[i];
+		if (impact.camera >= 0 && impact.type == BB_IMPACT_PREDICTED && !impact.confirmed &&
+			impact.global_id == prediction->global_id) {
+			return false;
+		}
+	}
+
+	event->impact_id = prediction->global_id;
+	event->track_id = prediction->track_id;
+	if (event->area_id == 0) {
+		event->x = prediction->position.x;
+		event->y = prediction->position.y;
+	}
+	event->camera_id = (uint32_t)camera;
+
+	return true;
+}
+
+//
+//	The other areas of a camera are not part of the wall, no other camera
+//	sees them and they don't tell where the ball is in it. Their impacts
+//	only take the ids of the whole wall, a confirmation the one of its
+//	prediction.
+//
+static bool submitAreaImpact(ImpactCoordinator * coordinator, int camera, BbImpactEvent * event) {
+
+	uint32_t local_id = event->impact_id;
+
+	//
+	//	A ball we never saw in the wall gets a record too old for
+	//	any other camera to take it, but it keeps its id from now on
+	//
+	int track_index = findTrack(coordinator, camera, event->track_id);
+	uint32_t track_id;
+	if (track_index >= 0) {
+		track_id = coordinator->tracks[track_index].global_id;
+	}
+	else {
+		track_id = ++coordinator->track_count;
+		addTrack(coordinator, camera, event->track_id, track_id, cv::Point2f(0.0f, 0.0f), -INFINITY);
+	}
+
+	CoordinatorImpact * prediction = NULL;
+
+	if (event->type == BB_IMPACT_CONFIRMED) {
+		for (int i = 0; i < COORDINATOR_MAX_IMPACTS; i++) {
+			CoordinatorImpact & impact = coordinator->impacts[i];
+			if (impact.camera == camera && impact.area_id != 0 && impact.type == BB_IMPACT_PREDICTED &&
+				!impact.confirmed && impact.local_id == local_id) {
+				prediction = &impact;
+			}
+		}
+	}
+
+	if (prediction != NULL) {
+		prediction->confirmed = true;
+	}
+
+	event->impact_id = (prediction != NULL ? prediction->global_id : ++coordinator->impact_count);
+	event->track_id = track_id;
+	event->camera_id = (uint32_t)camera;
+
+	rememberImpact(coordinator, event, camera, local_id, cv::Point2f(event->x, event->y));
+
+	return true;
+}
+
+void coordinator_reset(ImpactCoordinator * coordinator) {
+
+	for (int i = 0; i < COORDINATOR_MAX_TRACKS; i++) {
+		coordinator->tracks[i].used = false;
+	}
+	coordinator->next_track = 0;
+	coordinator->track_count = 0;
+
+	for (int i = 0; i < COORDINATOR_MAX_IMPACTS; i++) {
+		coordinator->impacts[i].camera = -1;
+	}
+	coordinator->next_impact = 0;
+	coordinator->impact_count = 0;
+
+}
+
+cv::Point2f coordinator_toWall(const BbWallRegion & region, cv::Point2f area_position) {
+	return cv::Point2f(
+		(float)(region.origin.x + area_position.x * region.size.x),
+		(float)(region.origin.y + area_position.y * region.size.y));
+}
+
+uint32_t coordinator_updateTrack(
+	ImpactCoordinator * coordinator,
+	int camera,
+	uint32_t local_id,
+	cv::Point2f area_position,
+	double time) {
+
+	cv::Point2f position = coordinator_toWall(coordinator->regions[camera], area_position);
+
+	int index = findTrack(coordinator, camera, local_id);
+	if (index >= 0) {
+		coordinator->tracks[index].position = position;
+		coordinator->tracks[index].time = time;
+		return coordinator->tracks[index].global_id;
+	}
+
+	//
+	//	A new ball for this camera, the closest one another camera saw
+	//	recently enough. The ball is not on the wall while flying so the
+	//	cameras disagree a bit about where it is, hence the radius.
+	//
+	const BbCoordinatorParameters & parameters = coordinator->parameters;
+	int best = -1;
+	float best_distance = parameters.handoff_radius;
+
+	for (int i = 0; i < COORDINATOR_MAX_TRACKS; i++) {
+
+		const CoordinatorTrack & track = coordinator->tracks[i];
+		if (!track.used || track.camera == camera || std::abs(time - track.time) > parameters.handoff_window) {
+			continue;
+		}
+
+		float distance = (float)cv::norm(track.position - position);
+		if (distance <= best_distance && !isClaimed(coordinator, camera, track.global_id, time)) {
+			best_distance = distance;
+			best = i;
+		}
+	}
+
+	uint32_t global_id = (best >= 0 ? coordinator->tracks[best].global_id : ++coordinator->track_count);
+
+	addTrack(coordinator, camera, local_id, global_id, position, time);
+
+	return global_id;
+}
+
+bool coordinator_submitImpact(
+	ImpactCoordinator * coordinator,
+	int camera,
+	BbImpactEvent * event) {
+
+	const BbCoordinatorParameters & parameters = coordinator->parameters;
+	cv::Point2f area_position(event->x, event->y);
+	cv::Point2f position = coordinator_toWall(coordinator->regions[camera], area_position);
+	uint32_t local_id = event->impact_id;
+
+	if (event->type == BB_IMPACT_CANCELLED) {
+		return cancelImpact(coordinator, camera, event);
+	}
+
+	if (event->area_id != 0) {
+		return submitAreaImpact(coordinator, camera, event);
+	}
+
+	//
+	//	Predictions are in the future so they don't tell where the ball is now
+	//
+	uint32_t track_id;
+	int track_index = findTrack(coordinator, camera, event->track_id);
+	if (track_index >= 0) {
+		track_id = coordinator->tracks[track_index].global_id;
+	}
+	else {
+		track_id = coordinator_updateTrack(coordinator, camera, event->track_id, area_position, event->timestamp);
+	}
+
+	//
+	//	The same hit seen by other cameras is the same ball, or at least
+	//	the same place and time. A confirmation takes the id of its
+	//	prediction even if another camera made it.
+	//
+	CoordinatorImpact * prediction = NULL;
+	CoordinatorImpact * duplicate = NULL;
+
+	for (int i = 0; i < COORDINATOR_MAX_IMPACTS; i++) {
+
+		CoordinatorImpact & impact = coordinator->impacts[i];
+		if (impact.camera < 0 || impact.area_id != 0) {
+			continue;
+		}
+
+		bool same_place =
+			std::abs(impact.time - event->timestamp) <= parameters.duplicate_window &&
+			cv::norm(impact.position - position) <= parameters.duplicate_radius;
+
+		if (event->type == BB_IMPACT_CONFIRMED) {
+
+			if (impact.type == BB_IMPACT_CONFIRMED && impact.camera != camera &&
+				(same_place || (impact.track_id == track_id && std::abs(impact.time - event->timestamp) <= parameters.duplicate_window))) {
+				duplicate = &impact;
+			}
+			else if (impact.type == BB_IMPACT_PREDICTED && !impact.confirmed &&
+				((impact.camera == camera && impact.local_id == local_id) ||
+				(impact.track_id == track_id && std::abs(impact.time - event->timestamp) <= parameters.handoff_window))) {
+				prediction = &impact;
+			}
+		}
+		else if (impact.type == BB_IMPACT_PREDICTED && !impact.confirmed && impact.camera != camera &&
+			(same_place || impact.track_id == track_id)) {
+			duplicate = &impact;
+		}
+	}
+
+	if (duplicate != NULL) {
+
+		//
+		//	We keep the prediction of this camera under the id we already
+		//	gave so its confirmation finds it
+		//
+		if (event->type == BB_IMPACT_PREDICTED) {
+			event->impact_id = duplicate->global_id;
+			event->track_id = track_id;
+			rememberImpact(coordinator, event, camera, local_id, position);
+		}
+
+		return false;
+	}
+
+	event->impact_id = (prediction != NULL ? prediction->global_id : ++coordinator->impact_count);
+	event->track_id = track_id;
+	event->x = position.x;
+	event->y = position.y;
+	event->camera_id = (uint32_t)camera;
+
+	//
+	//	Every prediction of this impact is done, whatever camera made it
+	//
+	if (event->type == BB_IMPACT_CONFIRMED) {
+		for (int i = 0; i < COORDINATOR_MAX_IMPACTS; i++) {
+			if (coordinator->impacts[i].camera >= 0 && coordinator->impacts[i].global_id == event->impact_id) {
+				coordinator->impacts[i].confirmed = true;
+			}
+		}
+	}
+
+	rememberImpact(coordinator, event, camera, local_id, position);
+
+	return true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "bopbol.h"
+
+//
+//	Amount of balls, among all the cameras, we remember where they
+//	were last seen to hand them from one camera to another
+//
+#define COORDINATOR_MAX_TRACKS 64
+
+//
+//	Amount of impacts we remember to tell the duplicates apart
+//
+#define COORDINATOR_MAX_IMPACTS 32
+
+//
+//	A ball as one of the cameras follows it, with the id shared by
+//	all the cameras and where it was last seen in the whole wall
+//
+struct CoordinatorTrack {
+	bool used;
+	int camera;
+	uint32_t local_id;
+	uint32_t global_id;
+	cv::Point2f position;
+	double time;
+};
+
+//
+//	An impact we already told the host about
+//
+struct CoordinatorImpact {
+	BbImpactType type;
+	int camera;
+	uint32_t area_id;
+	uint32_t local_id;
+	uint32_t global_id;
+	uint32_t track_id;
+	cv::Point2f position;
+	double time;
+	bool confirmed;
+};
+
+//
+//	Joins what several cameras see of one wall, each of them calibrated to
+//	a region of it. The balls keep their id when going from one camera to
+//	another and the impacts seen by more than one camera (where the regions
+//	overlap) are only reported once.
+//
+struct ImpactCoordinator {
+
+	BbCoordinatorParameters parameters;
+	std::vector<BbWallRegion> regions;
+
+	CoordinatorTrack tracks[COORDINATOR_MAX_TRACKS];
+	int next_track;
+	uint32_t track_count;
+
+	CoordinatorImpact impacts[COORDINATOR_MAX_IMPACTS];
+	int next_impact;
+	uint32_t impact_count;
+
+};
+
+
+//
+//	Forgets every ball and impact, keeping the parameters and the regions
+//
+void coordinator_reset(ImpactCoordinator * coordinator);
+
+
+//
+//	Where a point in the normalized area of a camera is in the whole wall
+//
+cv::Point2f coordinator_toWall(const BbWallRegion & region, cv::Point2f area_position);
+
+
+//
+//	Tells where a camera sees one of its balls, in its normalized area, and
+//	returns the id of the ball for the whole wall. A ball the camera didn't
+//	have yet is the one another camera saw close to there not long ago, if
+//	any, or a new one.
+//
+uint32_t coordinator_updateTrack(
+	ImpactCoordinator * coordinator,
+	int camera,
+	uint32_t local_id,
+	cv::Point2f area_position,
+	double time);
+
+
+//
+//	Moves an impact of a camera to the whole wall, with the ids of the ball
+//	and of the impact for the whole wall. Only the main area of the camera
+//	is part of the wall, impacts in its other areas keep their coordinates
+//	and are never duplicates nor hand their ball to another camera.
+//	Returns false if another camera already reported it and the host
+//	shouldn't hear about it again, or for a cancelled prediction while
+//	another camera still expects the impact.
+//
+bool coordinator_submitImpact(
+	ImpactCoordinator * coordinator,
+	int camera,
+	BbImpactEvent * event);
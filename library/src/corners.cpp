@@ -0,0 +1,215 @@
+#include "corners.h"
+#include <algorithm>
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in corners.h, the details are commented here.
+//
+
+void corners_reset(CornerEstimator * estimator) {
+
+	estimator->count = 0;
+
+	for (int i = 0; i < CORNERS_COUNT; i++) {
+		estimator->mean[i] = cv::Point2d(0.0, 0.0);
+		estimator->squared_distances[i] = 0.0;
+	}
+
+	estimator->rejected_count = 0;
+	estimator->stable_frames = 0;
+	estimator->sample_count = 0;
+
+}
+
+bool corners_add(
+	CornerEstimator * estimator,
+	const std::vector<cv::Point2f> & corners,
+	const BbAreaCalibrationParameters * parameters) {
+
+	if (corners.size() != CORNERS_COUNT) {
+		return false;
+	}
+
+	cv::Point2f * sample = estimator->samples[estimator->sample_count % CORNERS_MAX_SAMPLES];
+	for (int i = 0; i < CORNERS_COUNT; i++) {
+		sample[i] = corners[i];
+	}
+	estimator->sample_count++;
+
+	//
+	//	With a few detections we know where the corners are, a detection
+	//	with any corner further than the outlier distance (or than the
+	//	deviation, if it is bigger) is something else with the colour
+	//
+	if (estimator->count >= parameters->min_frames) {
+
+		double limit = std::max((double)parameters->outlier_distance, 3.0 * corners_getDeviation(estimator));
+
+		for (int i = 0; i < CORNERS_COUNT; i++) {
+			cv::Point2d offset = cv::Point2d(corners[i]) - estimator->mean[i];
+			if (offset.dot(offset) > limit * limit) {
+				estimator->rejected_count++;
+				estimator->stable_frames = 0;
+				return false;
+			}
+		}
+	}
+
+	estimator->count++;
+
+	for (int i = 0; i < CORNERS_COUNT; i++) {
+		cv::Point2d corner(corners[i]);
+		cv::Point2d delta = corner - estimator->mean[i];
+		estimator->mean[i] += delta / (double)estimator->count;
+		estimator->squared_distances[i] += delta.dot(corner - estimator->mean[i]);
+	}
+
+	if (estimator->count >= parameters->min_frames &&
+		corners_getDeviation(estimator) <= parameters->convergence_deviation) {
+		estimator->stable_frames++;
+	}
+	else {
+		estimator->stable_frames = 0;
+	}
+
+	return true;
+}
+
+double corners_getDeviation(const CornerEstimator * estimator) {
+
+	if (estimator->count < 2) {
+		return INFINITY;
+	}
+
+	double deviation = 0.0;
+	for (int i = 0; i < CORNERS_COUNT; i++) {
+		deviation = std::max(deviation, estimator->squared_distances[i] / (estimator->count - 1));
+	}
+
+	return std::sqrt(deviation);
+}
+
+bool corners_isConverged(const CornerEstimator * estimator, const BbAreaCalibrationParameters * parameters) {
+	return parameters->convergence_frames > 0 && estimator->stable_frames >= parameters->convergence_frames;
+}
+
+std::vector<cv::Point2f> corners_getMean(const CornerEstimator * estimator) {
+
+	std::vector<cv::Point2f> corners;
+
+	if (estimator->count > 0) {
+		for (int i = 0; i < CORNERS_COUNT; i++) {
+			corners.push_back(cv::Point2f((float)estimator->mean[i].x, (float)estimator->mean[i].y));
+		}
+	}
+
+	return corners;
+}
+
+bool corners_estimate(
+	const CornerEstimator * estimator,
+	const BbAreaCalibrationParameters * parameters,
+	std::vector<cv::Point2f> * corners,
+	float * reprojection_error,
+	float * inlier_ratio) {
+
+	uint32_t sample_count = std::min(estimator->sample_count, (uint32_t)CORNERS_MAX_SAMPLES);
+	if (estimator->count == 0 || sample_count == 0) {
+		return false;
+	}
+
+	std::vector<bool> inlier(sample_count, true);
+
+	if (parameters->aggregation == BB_CORNERS_MEDIAN) {
+
+		//
+		//	The median of every coordinate on its own, half of the
+		//	detections can be wrong and it doesn't move
+		//
+		cv::Point2f median[CORNERS_COUNT];
+		std::vector<float> values(sample_count);
+
+		for (int i = 0; i < CORNERS_COUNT; i++) {
+			for (int axis = 0; axis < 2; axis++) {
+
+				for (uint32_t s = 0; s < sample_count; s++) {
+					values[s] = (axis == 0 ? estimator->samples[s][i].x : estimator->samples[s][i].y);
+				}
+
+				std::nth_element(values.begin(), values.begin() + sample_count / 2, values.end());
+				(axis == 0 ? median[i].x : median[i].y) = values[sample_count / 2];
+			}
+		}
+
+		//
+		//	And the mean of the detections agreeing with it, for the precision
+		//
+		float limit = parameters->outlier_distance;
+		std::vector<cv::Point2d> sum(CORNERS_COUNT, cv::Point2d(0.0, 0.0));
+		uint32_t inlier_count = 0;
+
+		for (uint32_t s = 0; s < sample_count; s++) {
+
+			for (int i = 0; i < CORNERS_COUNT && inlier[s]; i++) {
+				cv::Point2f offset = estimator->samples[s][i] - median[i];
+				inlier[s] = (offset.dot(offset) <= limit * limit);
+			}
+
+			if (inlier[s]) {
+				for (int i = 0; i < CORNERS_COUNT; i++) {
+					sum[i] += cv::Point2d(estimator->samples[s][i]);
+				}
+				inlier_count++;
+			}
+		}
+
+		corners->clear();
+		for (int i = 0; i < CORNERS_COUNT; i++) {
+			corners->push_back(inlier_count > 0 ?
+				cv::Point2f((float)(sum[i].x / inlier_count), (float)(sum[i].y / inlier_count)) :
+				median[i]);
+		}
+	}
+	else {
+
+		//
+		//	The mean is of every detection we kept, not only the ones still
+		//	in the ring, and the running sums already have how far they are
+		//
+		*corners = corners_getMean(estimator);
+
+		double squared_error = 0.0;
+		for (int i = 0; i < CORNERS_COUNT; i++) {
+			squared_error += estimator->squared_distances[i];
+		}
+
+		*reprojection_error = (float)std::sqrt(squared_error / (estimator->count * CORNERS_COUNT));
+		*inlier_ratio = (float)estimator->count / (estimator->count + estimator->rejected_count);
+
+		return true;
+	}
+
+	//
+	//	The homography goes through the four corners exactly, so how far
+	//	the detections are from them is what it misses them by
+	//
+	double squared_error = 0.0;
+	uint32_t used = 0;
+
+	for (uint32_t s = 0; s < sample_count; s++) {
+		if (!inlier[s]) {
+			continue;
+		}
+		for (int i = 0; i < CORNERS_COUNT; i++) {
+			cv::Point2f offset = estimator->samples[s][i] - (*corners)[i];
+			squared_error += offset.dot(offset);
+		}
+		used++;
+	}
+
+	*reprojection_error = (used > 0 ? (float)std::sqrt(squared_error / (used * CORNERS_COUNT)) : 0.0f);
+	*inlier_ratio = (float)used / sample_count;
+
+	return true;
+}
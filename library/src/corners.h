@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "bopbol.h"
+
+//
+//	Amount of corners of the area
+//
+#define CORNERS_COUNT 4
+
+//
+//	Amount of the last detections we keep for the median
+//
+#define CORNERS_MAX_SAMPLES 64
+
+//
+//	Running statistics of the corners of the area found in the frames
+//	while calibrating, so it takes the same memory however long it lasts.
+//	Every corner has its mean and the sum of the squared distances to it
+//	(Welford's algorithm), and the corners too far from the mean once we
+//	know it are taken as wrong detections and left out.
+//
+struct CornerEstimator {
+
+	uint32_t count;
+	cv::Point2d mean[CORNERS_COUNT];
+	double squared_distances[CORNERS_COUNT];
+
+	//
+	//	Detections left out for being too far and frames in a
+	//	row the corners have been still enough to finish
+	//
+	uint32_t rejected_count;
+	uint32_t stable_frames;
+
+	//
+	//	Ring of the last detections, even the ones left out,
+	//	with the amount of them ever added
+	//
+	cv::Point2f samples[CORNERS_MAX_SAMPLES][CORNERS_COUNT];
+	uint32_t sample_count;
+
+};
+
+
+//
+//	Forgets every detection
+//
+void corners_reset(CornerEstimator * estimator);
+
+
+//
+//	Adds the sorted corners of a detection. Returns false if it was
+//	left out for being too far from the mean.
+//
+bool corners_add(
+	CornerEstimator * estimator,
+	const std::vector<cv::Point2f> & corners,
+	const BbAreaCalibrationParameters * parameters);
+
+
+//
+//	Standard deviation, in pixels, of the corner that moves the most
+//	between detections. Infinite until there are two of them.
+//
+double corners_getDeviation(const CornerEstimator * estimator);
+
+
+//
+//	Whether the corners have been still for the frames the
+//	parameters ask for, so the calibration can finish
+//
+bool corners_isConverged(const CornerEstimator * estimator, const BbAreaCalibrationParameters * parameters);
+
+
+//
+//	The mean of every corner, empty if there are no detections
+//
+std::vector<cv::Point2f> corners_getMean(const CornerEstimator * estimator);
+
+
+//
+//	The corners of the area joining the detections as the parameters say,
+//	with the root mean square distance (in pixels) from the corners of the
+//	detections used to them and the fraction of the detections used (all
+//	the ones ever added for the mean, the last ones for the median). Returns
+//	false if there are no detections.
+//
+bool corners_estimate(
+	const CornerEstimator * estimator,
+	const BbAreaCalibrationParameters * parameters,
+	std::vector<cv::Point2f> * corners,
+	float * reprojection_error,
+	float * inlier_ratio);
@@ -0,0 +1,137 @@
+#include "geometry.h"
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in geometry.h, the details are commented here.
+//
+
+void geometry_findWallNormal(
+	const cv::Matx33d & homography,
+	cv::Size frame_size,
+	const BbCameraIntrinsics * intrinsics,
+	cv::Vec3d * vanishing_point) {
+
+	double cx = 0.5 * frame_size.width;
+	double cy = 0.5 * frame_size.height;
+
+	//
+	//	The calibration is for square pixels if not, so we take the mean
+	//	focal length and scale it to our frames
+	//
+	double known_focal = 0.0;
+	if (intrinsics != NULL && intrinsics->valid && intrinsics->image_width > 0) {
+		double scale = (double)frame_size.width / intrinsics->image_width;
+		cx = intrinsics->cx * scale;
+		cy = intrinsics->cy * scale;
+		known_focal = 0.5 * (intrinsics->fx + intrinsics->fy) * scale;
+	}
+
+	//
+	//	The inverse maps the area to the frame, its first two columns are
+	//	where the axes of the wall vanish. We move them to the principal
+	//	point so the camera matrix is just the focal length.
+	//
+	cv::Matx33d area_to_frame = homography.inv();
+
+	cv::Vec3d axis_u(area_to_frame(0, 0), area_to_frame(1, 0), area_to_frame(2, 0));
+	cv::Vec3d axis_v(area_to_frame(0, 1), area_to_frame(1, 1), area_to_frame(2, 1));
+
+	for (cv::Vec3d * axis : { &axis_u, &axis_v }) {
+		(*axis)[0] -= cx * (*axis)[2];
+		(*axis)[1] -= cy * (*axis)[2];
+	}
+
+	//
+	//	The axes of the wall are perpendicular, so K^-1 * axis_u and
+	//	K^-1 * axis_v are too and that gives us the focal length:
+	//		(ux * vx + uy * vy) / f^2 + uz * vz = 0
+	//	When the wall is only turned around one of its axes one of uz and vz
+	//	is 0 and we can't tell, so we assume a webcam. When the camera faces
+	//	the wall both are 0, but then the normal doesn't depend on it.
+	//
+	double focal = (known_focal > 0.0 ? known_focal : GEOMETRY_DEFAULT_FOCAL * frame_size.width);
+
+	double depth_product = axis_u[2] * axis_v[2];
+	if (known_focal <= 0.0 && depth_product != 0.0) {
+		double squared_focal = -(axis_u[0] * axis_v[0] + axis_u[1] * axis_v[1]) / depth_product;
+		if (std::isfinite(squared_focal) && squared_focal > GEOMETRY_MIN_SQUARED_FOCAL) {
+			focal = std::sqrt(squared_focal);
+		}
+	}
+
+	//
+	//	The normal in camera space is the cross product of the axes
+	//	and projecting it back gives where it vanishes in the frame
+	//
+	cv::Vec3d ray_u(axis_u[0] / focal, axis_u[1] / focal, axis_u[2]);
+	cv::Vec3d ray_v(axis_v[0] / focal, axis_v[1] / focal, axis_v[2]);
+	cv::Vec3d normal = ray_u.cross(ray_v);
+
+	*vanishing_point = cv::Vec3d(
+		focal * normal[0] + cx * normal[2],
+		focal * normal[1] + cy * normal[2],
+		normal[2]);
+
+}
+
+cv::Point2f geometry_getWallAxis(const cv::Vec3d & vanishing_point, cv::Point2f position) {
+
+	//
+	//	Towards the vanishing point, or along it if it is at infinity.
+	//	The sign of the homogeneous coordinate would flip it.
+	//
+	double sign = (vanishing_point[2] < 0.0 ? -1.0 : 1.0);
+	double x = sign * (vanishing_point[0] - position.x * vanishing_point[2]);
+	double y = sign * (vanishing_point[1] - position.y * vanishing_point[2]);
+
+	double length = std::sqrt(x * x + y * y);
+	if (length <= 0.0) {
+		return cv::Point2f(1.0f, 0.0f);
+	}
+
+	return cv::Point2f((float)(x / length), (float)(y / length));
+}
+
+cv::Point2f geometry_undistortPoint(const BbCameraIntrinsics * intrinsics, int frame_width, cv::Point2f point) {
+
+	if (intrinsics == NULL || !intrinsics->valid || intrinsics->image_width <= 0 || frame_width <= 0) {
+		return point;
+	}
+
+	//
+	//	To normalized coordinates of the calibration, where the frame
+	//	is the same but maybe with another resolution
+	//
+	double scale = (double)intrinsics->image_width / frame_width;
+	double distorted_x = (point.x * scale - intrinsics->cx) / intrinsics->fx;
+	double distorted_y = (point.y * scale - intrinsics->cy) / intrinsics->fy;
+
+	double k1 = intrinsics->distortion[0];
+	double k2 = intrinsics->distortion[1];
+	double p1 = intrinsics->distortion[2];
+	double p2 = intrinsics->distortion[3];
+	double k3 = intrinsics->distortion[4];
+
+	//
+	//	The distortion has no closed inverse, but it is small enough
+	//	that applying it backwards a few times converges
+	//
+	double x = distorted_x;
+	double y = distorted_y;
+
+	for (int i = 0; i < GEOMETRY_UNDISTORT_ITERATIONS; i++) {
+
+		double r2 = x * x + y * y;
+		double inverse_radial = 1.0 / (1.0 + ((k3 * r2 + k2) * r2 + k1) * r2);
+		double tangential_x = 2.0 * p1 * x * y + p2 * (r2 + 2.0 * x * x);
+		double tangential_y = p1 * (r2 + 2.0 * y * y) + 2.0 * p2 * x * y;
+
+		x = (distorted_x - tangential_x) * inverse_radial;
+		y = (distorted_y - tangential_y) * inverse_radial;
+	}
+
+	return cv::Point2f(
+		(float)((x * intrinsics->fx + intrinsics->cx) / scale),
+		(float)((y * intrinsics->fy + intrinsics->cy) / scale));
+}
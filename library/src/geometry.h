@@ -0,0 +1,53 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include "bopbol.h"
+
+//
+//	Focal length, in widths of the frame, we assume when the homography
+//	can't tell it. About the 64 degrees of field of view of a webcam.
+//
+#define GEOMETRY_DEFAULT_FOCAL 0.8
+
+//
+//	Iterations to invert the distortion of the lens, enough
+//	for the distortion of a webcam
+//
+#define GEOMETRY_UNDISTORT_ITERATIONS 5
+
+//
+//	Smallest square focal length, in pixels, we believe from the homography
+//
+#define GEOMETRY_MIN_SQUARED_FOCAL 1.0
+
+//
+//	Finds where the normal of the wall vanishes in the image, the point
+//	every ball moving straight towards the wall goes to, from the homography
+//	that maps the frame to the normalized area. The camera is assumed to have
+//	square pixels and the principal point in the center of the frame, and its
+//	focal length comes from the corners of the area being a rectangle, if
+//	the wall is not just turned around one of its axes. The point is in
+//	homogeneous coordinates since it is often at infinity. With valid
+//	intrinsics they are used instead and the homography has to map
+//	undistorted positions.
+//
+void geometry_findWallNormal(
+	const cv::Matx33d & homography,
+	cv::Size frame_size,
+	const BbCameraIntrinsics * intrinsics,
+	cv::Vec3d * vanishing_point);
+
+
+//
+//	Unit direction in the image in which a ball at the given position
+//	moves when it goes straight towards the wall
+//
+cv::Point2f geometry_getWallAxis(const cv::Vec3d & vanishing_point, cv::Point2f position);
+
+
+//
+//	Where a point of a frame of the given width would be without the distortion
+//	of the lens, in the same pixels. Points are returned as they are if the
+//	intrinsics are not valid.
+//
+cv::Point2f geometry_undistortPoint(const BbCameraIntrinsics * intrinsics, int frame_width, cv::Point2f point);
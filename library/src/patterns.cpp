@@ -0,0 +1,202 @@
+#include "patterns.h"
+#include <algorithm>
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in patterns.h, the details are commented here.
+//
+
+//
+//	Stripe of a coordinate of the projector, and its Gray code, where
+//	neighbouring stripes differ in one bit so a pixel on the border
+//	of two stripes is wrong by one stripe at most
+//
+static int getGrayCode(int coordinate, int size) {
+	int stripe = (int)((long long)coordinate * (1 << PATTERNS_GRAY_BITS) / size);
+	return stripe ^ (stripe >> 1);
+}
+
+static int grayToStripe(int code) {
+	int stripe = code;
+	for (int shift = code >> 1; shift != 0; shift >>= 1) {
+		stripe ^= shift;
+	}
+	return stripe;
+}
+
+//
+//	Reads the Gray code of one axis at a pixel, the patterns of the axis start
+//	at first_pattern. Returns -1 if some bit is too close to call.
+//
+static int readCode(const PatternDecoder * decoder, int first_pattern, int x, int y) {
+
+	int code = 0;
+
+	for (int bit = 0; bit < PATTERNS_GRAY_BITS; bit++) {
+
+		int pattern = decoder->captures[first_pattern + 2 * bit].at<uchar>(y, x);
+		int inverse = decoder->captures[first_pattern + 2 * bit + 1].at<uchar>(y, x);
+
+		if (std::abs(pattern - inverse) < PATTERNS_MIN_BIT_DIFFERENCE) {
+			return -1;
+		}
+
+		code = (code << 1) | (pattern > inverse ? 1 : 0);
+	}
+
+	return code;
+}
+
+void patterns_reset(PatternDecoder * decoder, int projector_width, int projector_height) {
+	decoder->projector_width = projector_width;
+	decoder->projector_height = projector_height;
+	decoder->captures.assign(PATTERNS_COUNT, cv::Mat());
+}
+
+bool patterns_render(const PatternDecoder * decoder, int pattern_index, cv::Mat & image) {
+
+	if (pattern_index < 0 || pattern_index >= PATTERNS_COUNT ||
+		image.cols != decoder->projector_width || image.rows != decoder->projector_height || image.type() != CV_8UC1) {
+		return false;
+	}
+
+	if (pattern_index < 2) {
+		image.setTo(cv::Scalar(pattern_index == 0 ? 255 : 0));
+		return true;
+	}
+
+	int bit_index = (pattern_index - 2) / 2;
+	bool inverted = ((pattern_index - 2) % 2 == 1);
+	bool rows = (bit_index >= PATTERNS_GRAY_BITS);
+	int bit = PATTERNS_GRAY_BITS - 1 - (bit_index % PATTERNS_GRAY_BITS);
+
+	for (int y = 0; y < image.rows; y++) {
+
+		uchar * row = image.ptr<uchar>(y);
+
+		for (int x = 0; x < image.cols; x++) {
+
+			int code = (rows ?
+				getGrayCode(y, decoder->projector_height) :
+				getGrayCode(x, decoder->projector_width));
+
+			bool lit = (((code >> bit) & 1) != 0) != inverted;
+			row[x] = (lit ? 255 : 0);
+		}
+	}
+
+	return true;
+}
+
+bool patterns_add(PatternDecoder * decoder, int pattern_index, const cv::Mat & frame) {
+
+	if (pattern_index < 0 || pattern_index >= (int)decoder->captures.size() || frame.empty()) {
+		return false;
+	}
+
+	cv::cvtColor(frame, decoder->captures[pattern_index], CV_BGR2GRAY);
+
+	return true;
+}
+
+bool patterns_decode(
+	const PatternDecoder * decoder,
+	std::vector<cv::Point2f> * corners,
+	float * reprojection_error,
+	float * inlier_ratio) {
+
+	if (decoder->captures.size() != PATTERNS_COUNT) {
+		return false;
+	}
+
+	for (const cv::Mat & capture : decoder->captures) {
+		if (capture.empty() || capture.size() != decoder->captures[0].size()) {
+			return false;
+		}
+	}
+
+	const cv::Mat & white = decoder->captures[0];
+	const cv::Mat & black = decoder->captures[1];
+
+	//
+	//	Every decoded pixel is a point of the frame and the center of the
+	//	stripes it is in. The stripes are wider than the pixels of the
+	//	projector but the homography of many of them is much more precise,
+	//	the corners end up with sub-pixel accuracy.
+	//
+	std::vector<cv::Point2f> frame_points;
+	std::vector<cv::Point2f> projector_points;
+	float stripe_width = (float)decoder->projector_width / (1 << PATTERNS_GRAY_BITS);
+	float stripe_height = (float)decoder->projector_height / (1 << PATTERNS_GRAY_BITS);
+
+	for (int y = PATTERNS_SAMPLE_STEP / 2; y < white.rows; y += PATTERNS_SAMPLE_STEP) {
+		for (int x = PATTERNS_SAMPLE_STEP / 2; x < white.cols; x += PATTERNS_SAMPLE_STEP) {
+
+			//
+			//	Out of the projection, or so lit by the room the projector barely shows
+			//
+			if ((int)white.at<uchar>(y, x) - (int)black.at<uchar>(y, x) < PATTERNS_MIN_CONTRAST) {
+				continue;
+			}
+
+			int column_code = readCode(decoder, 2, x, y);
+			int row_code = readCode(decoder, 2 + 2 * PATTERNS_GRAY_BITS, x, y);
+			if (column_code < 0 || row_code < 0) {
+				continue;
+			}
+
+			frame_points.push_back(cv::Point2f((float)x, (float)y));
+			projector_points.push_back(cv::Point2f(
+				(grayToStripe(column_code) + 0.5f) * stripe_width,
+				(grayToStripe(row_code) + 0.5f) * stripe_height));
+		}
+	}
+
+	if (frame_points.size() < PATTERNS_MIN_POINTS) {
+		return false;
+	}
+
+	//
+	//	The threshold is in pixels of the projector, a couple of stripes
+	//	leaves out the pixels read wrong by reflections and the like
+	//
+	std::vector<uchar> inliers;
+	cv::Mat homography = cv::findHomography(frame_points, projector_points, cv::RANSAC,
+		2.0 * std::max(stripe_width, stripe_height), inliers);
+
+	if (homography.empty()) {
+		return false;
+	}
+
+	cv::Mat inverse = homography.inv();
+
+	std::vector<cv::Point2f> projector_corners;
+	projector_corners.push_back(cv::Point2f(0.f, 0.f));
+	projector_corners.push_back(cv::Point2f((float)decoder->projector_width, 0.f));
+	projector_corners.push_back(cv::Point2f((float)decoder->projector_width, (float)decoder->projector_height));
+	projector_corners.push_back(cv::Point2f(0.f, (float)decoder->projector_height));
+	cv::perspectiveTransform(projector_corners, *corners, inverse);
+
+	//
+	//	How far the points used are from where the stripes they are in fall in the frame
+	//
+	std::vector<cv::Point2f> mapped_points;
+	cv::perspectiveTransform(projector_points, mapped_points, inverse);
+
+	double squared_error = 0.0;
+	size_t used = 0;
+
+	for (size_t i = 0; i < frame_points.size(); i++) {
+		if (inliers[i]) {
+			cv::Point2f offset = mapped_points[i] - frame_points[i];
+			squared_error += offset.dot(offset);
+			used++;
+		}
+	}
+
+	*reprojection_error = (used > 0 ? (float)std::sqrt(squared_error / used) : 0.0f);
+	*inlier_ratio = (float)used / frame_points.size();
+
+	return used >= PATTERNS_MIN_POINTS;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+//
+//	Bits of the Gray code along every axis of the projector, the finest
+//	stripes are the projector size divided by 2 to this. Every bit is
+//	projected twice, as is and inverted, after a white and a black image.
+//
+#define PATTERNS_GRAY_BITS 7
+#define PATTERNS_COUNT (2 + 4 * PATTERNS_GRAY_BITS)
+
+//
+//	Smallest difference of brightness between the white and the black
+//	image for a pixel to be in the projection, and between a pattern and
+//	its inverse for the bit to be read
+//
+#define PATTERNS_MIN_CONTRAST 20
+#define PATTERNS_MIN_BIT_DIFFERENCE 5
+
+//
+//	Pixels between the points we decode along every axis of the frame
+//
+#define PATTERNS_SAMPLE_STEP 4
+
+//
+//	Fewest decoded points we trust the homography with
+//
+#define PATTERNS_MIN_POINTS 50
+
+//
+//	Frames of the known patterns the projector shows while calibrating, in
+//	grayscale, to find where every pixel of the frame is in the projector
+//
+struct PatternDecoder {
+	int projector_width = 0;
+	int projector_height = 0;
+	std::vector<cv::Mat> captures;
+};
+
+
+//
+//	Forgets the frames and sets the size of the image of the projector
+//
+void patterns_reset(PatternDecoder * decoder, int projector_width, int projector_height);
+
+
+//
+//	Draws one of the patterns in an 8 bit single channel image of the size of
+//	the projector: 0 is white, 1 is black and then every bit of the Gray code
+//	of the columns and after them of the rows, from the most significant one,
+//	followed by its inverse. Returns false if there is no such pattern.
+//
+bool patterns_render(const PatternDecoder * decoder, int pattern_index, cv::Mat & image);
+
+
+//
+//	Keeps the frame of the camera showing one of the patterns
+//
+bool patterns_add(PatternDecoder * decoder, int pattern_index, const cv::Mat & frame);
+
+
+//
+//	Decodes the frames of all the patterns and fits the homography from the
+//	frame to the projector to the points decoded, and returns the corners of
+//	the image of the projector in the frame, with the root mean square distance
+//	(in pixels of the frame) from the points used to where the homography puts
+//	them and the fraction of the decoded points used. Returns false if a pattern
+//	is missing or there are too few points.
+//
+bool patterns_decode(
+	const PatternDecoder * decoder,
+	std::vector<cv::Point2f> * corners,
+	float * reprojection_error,
+	float * inlier_ratio);
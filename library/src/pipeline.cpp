@@ -0,0 +1,452 @@
+#include "pipeline.h"
+#include "utils.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in pipeline.h, the interesting bits are commented here.
+//
+
+//
+//	The mask of a ball of radius r moving L pixels while the shutter is open
+//	is a capsule: a 2r x L rectangle with a half disk at each end. With its
+//	area A = 2rL + pi r^2 and its variance across the movement
+//		(2rL * r^2 / 3 + pi r^2 * r^2 / 4) / A
+//	we find r by bisection (the variance grows with r for a fixed area)
+//	and then L from the area.
+//
+static void estimateStreak(double area, double minor_variance, float * radius, float * length) {
+
+	double low = 0.0;
+	double high = std::sqrt(area / CV_PI);
+
+	for (int i = 0; i < 32; i++) {
+
+		double r = (low + high) * 0.5;
+		double rectangle = area - CV_PI * r * r;
+		double variance = (rectangle * r * r / 3.0 + CV_PI * r * r * r * r / 4.0) / area;
+
+		if (variance < minor_variance) {
+			low = r;
+		}
+		else {
+			high = r;
+		}
+	}
+
+	double r = (low + high) * 0.5;
+
+	*radius = (float)r;
+	*length = (float)(r > 0.0 ? (area - CV_PI * r * r) / (2.0 * r) : 0.0);
+}
+
+//
+//	Sum of the squares of all the integers from 0 to k (0 for k < 1)
+//
+static inline int64_t sumOfSquares(int64_t k) {
+	return k < 1 ? 0 : k * (k + 1) * (2 * k + 1) / 6;
+}
+
+static inline void addStats(BlobStats * target, const BlobStats & source) {
+	target->area += source.area;
+	target->sum_x += source.sum_x;
+	target->sum_y += source.sum_y;
+	target->sum_xx += source.sum_xx;
+	target->sum_xy += source.sum_xy;
+	target->sum_yy += source.sum_yy;
+	target->min_x = std::min(target->min_x, source.min_x);
+	target->min_y = std::min(target->min_y, source.min_y);
+	target->max_x = std::max(target->max_x, source.max_x);
+	target->max_y = std::max(target->max_y, source.max_y);
+}
+
+void pipeline_init(FramePipeline * pipeline, size_t cache_bytes, int max_tiles) {
+
+	pipeline->cache_bytes = cache_bytes;
+
+	pipeline->tiles.clear();
+	pipeline->tiles.resize(std::max(max_tiles, 1));
+	pipeline->tile_count = 0;
+
+	for (PipelineTile & tile : pipeline->tiles) {
+		tile.y_begin = 0;
+		tile.y_end = 0;
+		labeler_reset(&tile.labeler);
+	}
+
+	labeler_reset(&pipeline->merged_labeler);
+
+}
+
+int pipeline_getStripRows(const FramePipeline * pipeline, int width) {
+
+	size_t bytes_per_row = (size_t)std::max(width, 1) * PIPELINE_BYTES_PER_PIXEL;
+	int rows = (int)(pipeline->cache_bytes / bytes_per_row) - 2 * PIPELINE_HALO_ROWS;
+
+	return std::max(rows, PIPELINE_MIN_STRIP_ROWS);
+}
+
+void pipeline_processFrame(
+	FramePipeline * pipeline,
+	ThreadPool * pool,
+	const cv::Mat & frame,
+	const cv::Scalar & hsv_low,
+	const cv::Scalar & hsv_high,
+	std::vector<Blob> * blobs) {
+
+	int tile_count = pipeline_beginFrame(
+		pipeline, frame, hsv_low, hsv_high,
+		pool != NULL ? threadpool_getThreadCount(pool) : 1);
+
+	if (pool != NULL) {
+		threadpool_run(pool, tile_count, [pipeline](int tile_index) {
+			pipeline_processTile(pipeline, tile_index);
+		});
+	}
+	else {
+		pipeline_processTile(pipeline, 0);
+	}
+
+	pipeline_finishFrame(pipeline, blobs);
+
+}
+
+int pipeline_beginFrame(
+	FramePipeline * pipeline,
+	const cv::Mat & frame,
+	const cv::Scalar & hsv_low,
+	const cv::Scalar & hsv_high,
+	int tile_count) {
+
+	int rows = frame.rows;
+
+	tile_count = std::min(tile_count, rows / PIPELINE_MIN_TILE_ROWS);
+	tile_count = std::min(tile_count, (int)pipeline->tiles.size());
+	tile_count = std::max(tile_count, 1);
+
+	pipeline->frame = frame;
+	pipeline->hsv_low = hsv_low;
+	pipeline->hsv_high = hsv_high;
+	pipeline->tile_count = tile_count;
+
+	//
+	//	Splitting the rows as evenly as we can
+	//
+	for (int i = 0; i < tile_count; i++) {
+		pipeline->tiles[i].y_begin = (int)((int64_t)rows * i / tile_count);
+		pipeline->tiles[i].y_end = (int)((int64_t)rows * (i + 1) / tile_count);
+	}
+
+	return tile_count;
+}
+
+void pipeline_processTile(FramePipeline * pipeline, int tile_index) {
+
+	PipelineTile * tile = &pipeline->tiles[tile_index];
+	const cv::Mat & frame = pipeline->frame;
+
+	int rows = frame.rows;
+	int width = frame.cols;
+	int strip_rows = pipeline_getStripRows(pipeline, width);
+
+	//
+	//	The scratch buffers only get allocated again if the
+	//	resolution of the frames changes
+	//
+	tile->hsv_strip.create(strip_rows + 2 * PIPELINE_HALO_ROWS, width, CV_8UC3);
+	tile->mask_strip.create(strip_rows + 2 * PIPELINE_HALO_ROWS, width, CV_8UC1);
+	tile->morph_strip.create(strip_rows + 2 * PIPELINE_HALO_ROWS, width, CV_8UC1);
+
+	labeler_reset(&tile->labeler);
+	tile->first_row_runs.clear();
+
+	for (int y_begin = tile->y_begin; y_begin < tile->y_end; y_begin += strip_rows) {
+
+		int y_end = std::min(tile->y_end, y_begin + strip_rows);
+
+		//
+		//	The rows we actually compute include the halo so the morphology
+		//	of the rows we keep is exactly the one of the whole image. The halo
+		//	reads into the neighbouring tiles (the frame is only read) and at the
+		//	top and bottom of the image we replicate the border as before.
+		//
+		int halo_begin = std::max(0, y_begin - PIPELINE_HALO_ROWS);
+		int halo_end = std::min(rows, y_end + PIPELINE_HALO_ROWS);
+		int halo_rows = halo_end - halo_begin;
+
+		cv::Mat hsv = tile->hsv_strip.rowRange(0, halo_rows);
+		cv::Mat mask = tile->mask_strip.rowRange(0, halo_rows);
+		cv::Mat morph = tile->morph_strip.rowRange(0, halo_rows);
+
+		cv::cvtColor(frame.rowRange(halo_begin, halo_end), hsv, CV_BGR2HSV);
+
+		//
+		//	The morphology scratch is free until then, the hue
+		//	of reddish balls needs it to wrap around
+		//
+		utilscv_inRangeHSV(hsv, pipeline->hsv_low, pipeline->hsv_high, mask, morph);
+
+		//
+		//	BORDER_ISOLATED is important here, otherwise OpenCV would read
+		//	the stale rows of the scratch buffers below our strip as the border
+		//
+		cv::erode(mask, morph, cv::Mat(), cv::Point(-1, -1), PIPELINE_MORPHOLOGY_ITERATIONS,
+			cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
+		cv::dilate(morph, mask, cv::Mat(), cv::Point(-1, -1), PIPELINE_MORPHOLOGY_ITERATIONS,
+			cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
+
+		for (int y = y_begin; y < y_end; y++) {
+			labeler_scanRow(&tile->labeler, mask.ptr<uchar>(y - halo_begin), width, y);
+
+			if (y == tile->y_begin) {
+				tile->first_row_runs = tile->labeler.current_runs;
+			}
+		}
+	}
+
+}
+
+void pipeline_finishFrame(FramePipeline * pipeline, std::vector<Blob> * blobs) {
+
+	//
+	//	With a single tile there is nothing to stitch
+	//
+	if (pipeline->tile_count == 1) {
+		labeler_finish(&pipeline->tiles[0].labeler, blobs);
+		return;
+	}
+
+	StripLabeler * merged = &pipeline->merged_labeler;
+	labeler_reset(merged);
+	pipeline->label_offsets.clear();
+
+	//
+	//	We put the labels of the tiles one after the other. Tiles are in
+	//	order and their labels are in raster order, so the global labels
+	//	are in raster order too and the smallest label of every component
+	//	is the same one the single tile labeling would find.
+	//
+	for (int i = 0; i < pipeline->tile_count; i++) {
+
+		const StripLabeler & labeler = pipeline->tiles[i].labeler;
+		int offset = (int)merged->parent.size();
+
+		pipeline->label_offsets.push_back(offset);
+
+		for (int parent : labeler.parent) {
+			merged->parent.push_back(parent + offset);
+		}
+		merged->stats.insert(merged->stats.end(), labeler.stats.begin(), labeler.stats.end());
+	}
+
+	//
+	//	And we merge the components touching across every seam, always
+	//	going top to bottom and left to right so this is deterministic
+	//
+	for (int i = 1; i < pipeline->tile_count; i++) {
+
+		const std::vector<PixelRun> & above = pipeline->tiles[i - 1].labeler.current_runs;
+		const std::vector<PixelRun> & below = pipeline->tiles[i].first_row_runs;
+		int offset_above = pipeline->label_offsets[i - 1];
+		int offset_below = pipeline->label_offsets[i];
+
+		size_t first_candidate = 0;
+		for (const PixelRun & run : below) {
+
+			while (first_candidate < above.size() && above[first_candidate].end < run.start - 1) {
+				first_candidate++;
+			}
+
+			for (size_t j = first_candidate; j < above.size() && above[j].start <= run.end + 1; j++) {
+				labeler_merge(merged, above[j].label + offset_above, run.label + offset_below);
+			}
+		}
+	}
+
+	labeler_finish(merged, blobs);
+
+}
+
+void labeler_reset(StripLabeler * labeler) {
+
+	//
+	//	clear() keeps the capacity so after the first frames
+	//	we are not allocating anything anymore
+	//
+	labeler->parent.clear();
+	labeler->stats.clear();
+	labeler->previous_runs.clear();
+	labeler->current_runs.clear();
+
+}
+
+void labeler_scanRow(StripLabeler * labeler, const uchar * row, int width, int y) {
+
+	std::swap(labeler->previous_runs, labeler->current_runs);
+	labeler->current_runs.clear();
+
+	const std::vector<PixelRun> & previous = labeler->previous_runs;
+	size_t first_candidate = 0;
+
+	int x = 0;
+	while (x < width) {
+
+		if (!row[x]) {
+			x++;
+			continue;
+		}
+
+		int start = x;
+		while (x < width && row[x]) {
+			x++;
+		}
+		int end = x - 1;
+
+		//
+		//	We use 8-connectivity like findContours did, so a run touches
+		//	the runs of the previous row overlapping [start - 1, end + 1]
+		//
+		while (first_candidate < previous.size() && previous[first_candidate].end < start - 1) {
+			first_candidate++;
+		}
+
+		int label = -1;
+		for (size_t i = first_candidate; i < previous.size() && previous[i].start <= end + 1; i++) {
+			if (label < 0) {
+				label = previous[i].label;
+			}
+			else {
+				labeler_merge(labeler, label, previous[i].label);
+			}
+		}
+
+		if (label < 0) {
+			label = (int)labeler->parent.size();
+			labeler->parent.push_back(label);
+
+			BlobStats empty;
+			empty.area = 0;
+			empty.sum_x = empty.sum_y = empty.sum_xx = empty.sum_xy = empty.sum_yy = 0;
+			empty.min_x = empty.min_y = INT_MAX;
+			empty.max_x = empty.max_y = INT_MIN;
+			labeler->stats.push_back(empty);
+		}
+
+		//
+		//	Closed forms for the moments of the whole run
+		//
+		int64_t n = end - start + 1;
+		int64_t sum_x = n * (start + end) / 2;
+
+		BlobStats run;
+		run.area = n;
+		run.sum_x = sum_x;
+		run.sum_y = n * y;
+		run.sum_xx = sumOfSquares(end) - sumOfSquares(start - 1);
+		run.sum_xy = sum_x * y;
+		run.sum_yy = n * y * y;
+		run.min_x = start;
+		run.max_x = end;
+		run.min_y = y;
+		run.max_y = y;
+
+		addStats(&labeler->stats[label], run);
+
+		labeler->current_runs.push_back(PixelRun{ start, end, label });
+	}
+
+}
+
+int labeler_findRoot(StripLabeler * labeler, int label) {
+
+	//
+	//	Path halving, good enough and without recursion
+	//
+	while (labeler->parent[label] != label) {
+		labeler->parent[label] = labeler->parent[labeler->parent[label]];
+		label = labeler->parent[label];
+	}
+	return label;
+}
+
+void labeler_merge(StripLabeler * labeler, int label_a, int label_b) {
+
+	int root_a = labeler_findRoot(labeler, label_a);
+	int root_b = labeler_findRoot(labeler, label_b);
+
+	if (root_a == root_b) {
+		return;
+	}
+
+	//
+	//	The smallest label stays as the root so the order of the
+	//	blobs only depends on where they start in the image
+	//
+	if (root_a < root_b) {
+		labeler->parent[root_b] = root_a;
+	}
+	else {
+		labeler->parent[root_a] = root_b;
+	}
+
+}
+
+void labeler_finish(StripLabeler * labeler, std::vector<Blob> * blobs) {
+
+	blobs->clear();
+
+	//
+	//	Roots are always smaller than the labels pointing to them
+	//	so going in order every root is complete when we read it
+	//
+	for (int label = 0; label < (int)labeler->parent.size(); label++) {
+		int root = labeler_findRoot(labeler, label);
+		if (root != label) {
+			addStats(&labeler->stats[root], labeler->stats[label]);
+		}
+	}
+
+	for (int label = 0; label < (int)labeler->parent.size(); label++) {
+
+		if (labeler->parent[label] != label) {
+			continue;
+		}
+
+		const BlobStats & stats = labeler->stats[label];
+
+		Blob blob;
+		blob.stats = stats;
+		blob.centroid = cv::Point2f(
+			(float)((double)stats.sum_x / (double)stats.area),
+			(float)((double)stats.sum_y / (double)stats.area));
+		blob.center = cv::Point2f(
+			(float)(stats.min_x + stats.max_x) * 0.5f,
+			(float)(stats.min_y + stats.max_y) * 0.5f);
+		blob.radius = (float)(std::max(stats.max_x - stats.min_x, stats.max_y - stats.min_y) + 1) * 0.5f;
+		blob.fill_ratio = (float)((double)stats.area / (CV_PI * blob.radius * blob.radius));
+
+		//
+		//	The direction of the streak is the main axis of the covariance
+		//	of the pixels, and its size comes from the variance across it
+		//
+		double mean_x = (double)stats.sum_x / (double)stats.area;
+		double mean_y = (double)stats.sum_y / (double)stats.area;
+		double covariance_xx = (double)stats.sum_xx / (double)stats.area - mean_x * mean_x;
+		double covariance_xy = (double)stats.sum_xy / (double)stats.area - mean_x * mean_y;
+		double covariance_yy = (double)stats.sum_yy / (double)stats.area - mean_y * mean_y;
+
+		double half_trace = (covariance_xx + covariance_yy) * 0.5;
+		double half_difference = (covariance_xx - covariance_yy) * 0.5;
+		double spread = std::sqrt(half_difference * half_difference + covariance_xy * covariance_xy);
+		double minor_variance = std::max(half_trace - spread, 0.0);
+		double angle = 0.5 * std::atan2(2.0 * covariance_xy, covariance_xx - covariance_yy);
+
+		blob.streak_direction = cv::Point2f((float)std::cos(angle), (float)std::sin(angle));
+		estimateStreak((double)stats.area, minor_variance, &blob.streak_radius, &blob.streak_length);
+
+		blobs->push_back(blob);
+	}
+
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "threadpool.h"
+
+//
+//	Amount of erode and dilate iterations applied to the ball
+//	mask (3x3 kernel each) to avoid bumps and stuff
+//
+#define PIPELINE_MORPHOLOGY_ITERATIONS 2
+
+//
+//	Extra rows processed above and below every strip so the
+//	erosion followed by the dilation see the same neighbourhood
+//	they would see on the whole image
+//
+#define PIPELINE_HALO_ROWS (2 * PIPELINE_MORPHOLOGY_ITERATIONS)
+
+//
+//	Never go lower than this amount of rows per strip, even if
+//	the frame is so wide that the cache budget would ask for it
+//
+#define PIPELINE_MIN_STRIP_ROWS 8
+
+//
+//	Bytes touched per pixel while a strip goes through the pipeline:
+//	3 for the BGR source, 3 for the HSV conversion, 1 for the mask and
+//	1 for the morphology scratch buffer
+//
+#define PIPELINE_BYTES_PER_PIXEL 8
+
+//
+//	Tiles smaller than this are not worth sending to another core
+//
+#define PIPELINE_MIN_TILE_ROWS 32
+
+
+//
+//	Accumulated statistics for a connected component of the mask.
+//	Everything is stored as integers so merging components coming from
+//	different strips gives exactly the same result in any order.
+//
+struct BlobStats {
+
+	//
+	//	Amount of pixels in the component
+	//
+	int64_t area;
+
+	//
+	//	Raw moments of the pixel coordinates
+	//
+	int64_t sum_x;
+	int64_t sum_y;
+	int64_t sum_xx;
+	int64_t sum_xy;
+	int64_t sum_yy;
+
+	//
+	//	Bounding box, both ends included
+	//
+	int min_x;
+	int min_y;
+	int max_x;
+	int max_y;
+
+};
+
+//
+//	A blob of ball coloured pixels found in the frame with the values
+//	we derive from its statistics
+//
+struct Blob {
+
+	BlobStats stats;
+
+	//
+	//	Center of mass of the pixels
+	//
+	cv::Point2f centroid;
+
+	//
+	//	Center and radius of the circle enclosing the bounding box
+	//	sides, our replacement for cv::minEnclosingCircle. The sides
+	//	count the pixels of both ends, like the contour did.
+	//
+	cv::Point2f center;
+	float radius;
+
+	//
+	//	Fraction of that circle covered by the pixels, about 1 for a
+	//	ball and close to 0 for lines and slivers of the background,
+	//	the shape test the polygon approximation of the contour did
+	//
+	float fill_ratio;
+
+	//
+	//	A fast ball is smeared along the segment it travelled while the
+	//	shutter was open. Direction (unit vector, the sign is unknown) and
+	//	length of that segment and the radius of the ball across it, all
+	//	from the second moments of the pixels.
+	//
+	cv::Point2f streak_direction;
+	float streak_length;
+	float streak_radius;
+
+};
+
+//
+//	A horizontal run of mask pixels in a row, both ends included
+//
+struct PixelRun {
+	int start;
+	int end;
+	int label;
+};
+
+//
+//	State for the streaming connected component labeling. Rows are fed
+//	one after the other and only the runs of the previous row are kept
+//	around, labels are merged with a union find structure.
+//
+struct StripLabeler {
+
+	//
+	//	Union find parent of every label, roots point to themselves.
+	//	The root is always the smallest label of the component.
+	//
+	std::vector<int> parent;
+
+	//
+	//	Statistics accumulated for every label, they are folded
+	//	into their root when the frame is finished.
+	//
+	std::vector<BlobStats> stats;
+
+	//
+	//	Runs of the previous and the current row
+	//
+	std::vector<PixelRun> previous_runs;
+	std::vector<PixelRun> current_runs;
+
+};
+
+//
+//	A horizontal band of the frame processed by one core. Every tile
+//	has its own scratch buffers and labeler so they never share state
+//	while running.
+//
+struct PipelineTile {
+
+	//
+	//	Rows of the frame owned by this tile, end not included
+	//
+	int y_begin;
+	int y_end;
+
+	//
+	//	Scratch buffers big enough for one strip plus its halo rows
+	//
+	cv::Mat hsv_strip;
+	cv::Mat mask_strip;
+	cv::Mat morph_strip;
+
+	StripLabeler labeler;
+
+	//
+	//	Runs of the first row of the tile, needed to stitch it to
+	//	the tile above. The runs of the last row are the current
+	//	runs of the labeler once the tile is done.
+	//
+	std::vector<PixelRun> first_row_runs;
+
+};
+
+//
+//	Strip based executor for the per pixel stages of the ball detection.
+//	The frame is split in horizontal tiles that can run on different cores,
+//	and inside every tile bands of rows sized to fit in the L2 cache go through
+//	the HSV conversion, the thresholding, the morphology and the labeling
+//	before the next band starts, so the intermediate images are never fully
+//	materialized.
+//
+struct FramePipeline {
+
+	//
+	//	Amount of bytes of cache we want a strip to fit in
+	//
+	size_t cache_bytes;
+
+	//
+	//	Tiles of the frame, only the first tile_count are in use
+	//
+	std::vector<PipelineTile> tiles;
+	int tile_count;
+
+	//
+	//	The frame and thresholds of the frame being processed
+	//
+	cv::Mat frame;
+	cv::Scalar hsv_low;
+	cv::Scalar hsv_high;
+
+	//
+	//	Labels of all the tiles put together to merge the
+	//	components crossing the seams between tiles
+	//
+	StripLabeler merged_labeler;
+	std::vector<int> label_offsets;
+
+};
+
+
+//
+//	Inits the pipeline for the given cache budget in bytes and
+//	the maximum amount of tiles we will split the frames in
+//
+void pipeline_init(FramePipeline * pipeline, size_t cache_bytes, int max_tiles);
+
+
+//
+//	Returns the amount of rows (without the halo) that a strip of
+//	an image with the given width will have
+//
+int pipeline_getStripRows(const FramePipeline * pipeline, int width);
+
+
+//
+//	Runs the whole frame through the pipeline looking for pixels in the
+//	given HSV range and fills the blobs vector with the components found,
+//	ordered by the position of their first pixel in raster order. The tiles
+//	run in the given pool (or in the calling thread if it is NULL) and the
+//	result is exactly the same whatever the amount of tiles.
+//
+void pipeline_processFrame(
+	FramePipeline * pipeline,
+	ThreadPool * pool,
+	const cv::Mat & frame,
+	const cv::Scalar & hsv_low,
+	const cv::Scalar & hsv_high,
+	std::vector<Blob> * blobs);
+
+
+//
+//	Splits the frame in (at most) the given amount of tiles and gets
+//	everything ready to process them. Returns the amount of tiles used.
+//
+int pipeline_beginFrame(
+	FramePipeline * pipeline,
+	const cv::Mat & frame,
+	const cv::Scalar & hsv_low,
+	const cv::Scalar & hsv_high,
+	int tile_count);
+
+
+//
+//	Processes one of the tiles, different tiles can run at the same time
+//
+void pipeline_processTile(FramePipeline * pipeline, int tile_index);
+
+
+//
+//	Stitches the components of all the tiles together once they are
+//	done and fills the blobs vector with the result
+//
+void pipeline_finishFrame(FramePipeline * pipeline, std::vector<Blob> * blobs);
+
+
+//
+//	Resets the labeler to start labeling a new frame
+//
+void labeler_reset(StripLabeler * labeler);
+
+
+//
+//	Labels one row of the mask, rows must be fed in order
+//
+void labeler_scanRow(StripLabeler * labeler, const uchar * row, int width, int y);
+
+
+//
+//	Finds the root label of a given label
+//
+int labeler_findRoot(StripLabeler * labeler, int label);
+
+
+//
+//	Merges the components of two labels
+//
+void labeler_merge(StripLabeler * labeler, int label_a, int label_b);
+
+
+//
+//	Folds the statistics of every label into its root and fills
+//	the blobs vector with the resulting components
+//
+void labeler_finish(StripLabeler * labeler, std::vector<Blob> * blobs);
@@ -0,0 +1,109 @@
+#include "shadow.h"
+#include "utils.h"
+#include <algorithm>
+
+//
+//	Comments explaining the types and functions are
+//	in shadow.h, the details are commented here.
+//
+
+bool shadow_find(
+	ShadowDetector * detector,
+	const cv::Mat & frame,
+	cv::Point2f ball_position,
+	float ball_radius,
+	const cv::Scalar & ball_hsv_low,
+	const cv::Scalar & ball_hsv_high,
+	float darkness,
+	cv::Point2f * shadow_position) {
+
+	//
+	//	Just a small window around the ball, the shadow
+	//	can't be far from it if it is about to hit the wall
+	//
+	int half_size = (int)std::ceil(ball_radius * SHADOW_SEARCH_RADII);
+	cv::Rect window(
+		(int)ball_position.x - half_size,
+		(int)ball_position.y - half_size,
+		2 * half_size + 1,
+		2 * half_size + 1);
+	window &= cv::Rect(0, 0, frame.cols, frame.rows);
+
+	if (window.area() == 0) {
+		return false;
+	}
+
+	cv::cvtColor(frame(window), detector->hsv, cv::COLOR_BGR2HSV);
+	utilscv_inRangeHSV(detector->hsv, ball_hsv_low, ball_hsv_high, detector->ball_mask, detector->dark_mask);
+
+	//
+	//	The median brightness of what is not the ball is what the
+	//	projected image looks like here, from a histogram of the value
+	//
+	int histogram[256] = { 0 };
+	int pixel_count = 0;
+
+	for (int y = 0; y < window.height; y++) {
+		const cv::Vec3b * hsv_row = detector->hsv.ptr<cv::Vec3b>(y);
+		const uchar * ball_row = detector->ball_mask.ptr<uchar>(y);
+		for (int x = 0; x < window.width; x++) {
+			if (!ball_row[x]) {
+				histogram[hsv_row[x][2]]++;
+				pixel_count++;
+			}
+		}
+	}
+
+	if (pixel_count == 0) {
+		return false;
+	}
+
+	int median = 0;
+	for (int accumulated = 0; median < 255; median++) {
+		accumulated += histogram[median];
+		if (2 * accumulated >= pixel_count) {
+			break;
+		}
+	}
+
+	int threshold = (int)(median * darkness);
+
+	//
+	//	Dark pixels that are not the ball, labeled row by row
+	//	the same way the pipeline labels the ball
+	//
+	detector->dark_mask.create(window.size(), CV_8UC1);
+	labeler_reset(&detector->labeler);
+
+	for (int y = 0; y < window.height; y++) {
+
+		const cv::Vec3b * hsv_row = detector->hsv.ptr<cv::Vec3b>(y);
+		const uchar * ball_row = detector->ball_mask.ptr<uchar>(y);
+		uchar * dark_row = detector->dark_mask.ptr<uchar>(y);
+
+		for (int x = 0; x < window.width; x++) {
+			dark_row[x] = (!ball_row[x] && hsv_row[x][2] < threshold) ? 255 : 0;
+		}
+
+		labeler_scanRow(&detector->labeler, dark_row, window.width, y);
+	}
+
+	detector->blobs.clear();
+	labeler_finish(&detector->labeler, &detector->blobs);
+
+	int64_t min_area = (int64_t)(CV_PI * ball_radius * ball_radius * SHADOW_MIN_AREA_FRACTION);
+	const Blob * shadow = NULL;
+
+	for (const Blob & blob : detector->blobs) {
+		if (blob.stats.area >= min_area && (shadow == NULL || blob.stats.area > shadow->stats.area)) {
+			shadow = &blob;
+		}
+	}
+
+	if (shadow == NULL) {
+		return false;
+	}
+
+	*shadow_position = shadow->centroid + cv::Point2f((float)window.x, (float)window.y);
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "pipeline.h"
+
+//
+//	Size of the square we look for the shadow in, in radii
+//	of the ball from its center to every side
+//
+#define SHADOW_SEARCH_RADII 6.0f
+
+//
+//	The shadow is in contact with the ball when their
+//	centers are closer than this amount of radii
+//
+#define SHADOW_CONTACT_RADII 1.0f
+
+//
+//	Smallest shadow we believe, as a fraction of the area of the ball
+//
+#define SHADOW_MIN_AREA_FRACTION 0.25f
+
+//
+//	Scratch buffers to look for the shadow of a ball under the projector.
+//	They are reused from frame to frame so we don't allocate anything
+//	once they are big enough.
+//
+struct ShadowDetector {
+
+	cv::Mat hsv;
+	cv::Mat ball_mask;
+	cv::Mat dark_mask;
+
+	StripLabeler labeler;
+	std::vector<Blob> blobs;
+
+};
+
+
+//
+//	Looks for the shadow the projector casts of a ball at the given position:
+//	the biggest blob around it that is darker than the given fraction of the
+//	median brightness of the surroundings and is not the ball itself. Returns
+//	true if there is one, with the position of its centroid in the frame.
+//
+bool shadow_find(
+	ShadowDetector * detector,
+	const cv::Mat & frame,
+	cv::Point2f ball_position,
+	float ball_radius,
+	const cv::Scalar & ball_hsv_low,
+	const cv::Scalar & ball_hsv_high,
+	float darkness,
+	cv::Point2f * shadow_position);
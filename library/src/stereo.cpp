@@ -0,0 +1,72 @@
+#include "stereo.h"
+#include <algorithm>
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in stereo.h, the details are commented here.
+//
+
+int stereo_matchBlob(
+	const std::vector<Blob> & blobs,
+	float radius_threshold,
+	float min_fill_ratio,
+	const cv::Matx33d & homography,
+	cv::Point2f area_position,
+	float max_parallax,
+	cv::Point2f * matched_area_position) {
+
+	int best = -1;
+	float best_distance = max_parallax;
+
+	for (int i = 0; i < (int)blobs.size(); i++) {
+
+		if (blobs[i].radius <= radius_threshold || blobs[i].fill_ratio < min_fill_ratio) {
+			continue;
+		}
+
+		cv::Vec3d mapped = homography * cv::Vec3d(blobs[i].centroid.x, blobs[i].centroid.y, 1.0);
+		if (mapped[2] == 0.0) {
+			continue;
+		}
+
+		cv::Point2f position((float)(mapped[0] / mapped[2]), (float)(mapped[1] / mapped[2]));
+		float distance = (float)cv::norm(position - area_position);
+
+		if (distance <= best_distance) {
+			best_distance = distance;
+			best = i;
+			*matched_area_position = position;
+		}
+	}
+
+	return best;
+}
+
+bool stereo_findContactTime(
+	const double times[3],
+	const float parallaxes[3],
+	float restitution,
+	double * contact_time) {
+
+	double dt = times[1] - times[0];
+	if (dt <= 0.0) {
+		return false;
+	}
+
+	double slope_in = (parallaxes[1] - parallaxes[0]) / dt;
+	if (slope_in >= 0.0) {
+		return false;
+	}
+
+	//
+	//	The way in: p1 + slope_in * (t - t1)
+	//	The way out: p2 - slope_in * restitution * (t - t2)
+	//	They meet (at the wall) when both are the same
+	//
+	double time = (parallaxes[2] - parallaxes[1] + slope_in * (times[1] + restitution * times[2])) /
+		(slope_in * (1.0 + restitution));
+
+	*contact_time = std::min(std::max(time, times[1]), times[2]);
+	return true;
+}
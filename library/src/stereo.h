@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "pipeline.h"
+
+//
+//	Changes of the parallax, in normalized coordinates of the area,
+//	smaller than this are noise and don't tell where the ball goes
+//
+#define STEREO_PARALLAX_NOISE 0.005f
+
+//
+//	Largest disagreement of the cameras, in normalized coordinates of the
+//	area, for two blobs to be the same ball
+//
+#define STEREO_MAX_PARALLAX 1.0f
+
+//
+//	Finds the blob of the second camera that is the ball we see at the given
+//	position of the area with the first one. Both cameras see the same point
+//	of the area when the ball is on the wall, and the further from it the more
+//	they disagree (the parallax), so it is the closest one up to max_parallax.
+//	Only the blobs that could be a ball for the first camera count. Returns
+//	its index, or -1 if there is none, with its position in the area.
+//
+int stereo_matchBlob(
+	const std::vector<Blob> & blobs,
+	float radius_threshold,
+	float min_fill_ratio,
+	const cv::Matx33d & homography,
+	cv::Point2f area_position,
+	float max_parallax,
+	cv::Point2f * matched_area_position);
+
+
+//
+//	Time at which the ball touched the wall from the parallax of its last
+//	three detections, the older two on the way in and the newest one on the
+//	way out. The parallax is proportional to the distance to the wall close
+//	to it, so it goes down linearly and back up with the restitution. Returns
+//	false if the way in is not going towards the wall.
+//
+bool stereo_findContactTime(
+	const double times[3],
+	const float parallaxes[3],
+	float restitution,
+	double * contact_time);
@@ -0,0 +1,112 @@
+#include "threadpool.h"
+
+//
+//	Comments explaining the types and functions are
+//	in threadpool.h
+//
+
+static void runPendingTasks(ThreadPool * pool) {
+	for (int i = pool->next_task.fetch_add(1); i < pool->task_count; i = pool->next_task.fetch_add(1)) {
+		(*pool->task)(i);
+	}
+}
+
+static void workerFunction(ThreadPool * pool) {
+
+	unsigned int seen_generation = 0;
+
+	for (;;) {
+
+		std::unique_lock<std::mutex> lock(pool->mutex);
+		pool->work_available.wait(lock, [&]() {
+			return pool->stopping || pool->generation != seen_generation;
+		});
+
+		if (pool->stopping) {
+			return;
+		}
+
+		seen_generation = pool->generation;
+		lock.unlock();
+
+		runPendingTasks(pool);
+
+		lock.lock();
+		if (--pool->pending_workers == 0) {
+			pool->work_finished.notify_all();
+		}
+	}
+}
+
+void threadpool_init(ThreadPool * pool, int thread_count) {
+
+	if (thread_count <= 0) {
+		thread_count = (int)std::thread::hardware_concurrency();
+	}
+
+	//
+	//	hardware_concurrency can return 0 if it does not know,
+	//	and the calling thread already counts as one
+	//
+	int worker_count = thread_count > 1 ? thread_count - 1 : 0;
+
+	pool->stopping = false;
+	for (int i = 0; i < worker_count; i++) {
+		pool->workers.push_back(std::thread(workerFunction, pool));
+	}
+
+}
+
+void threadpool_destroy(ThreadPool * pool) {
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->stopping = true;
+	}
+	pool->work_available.notify_all();
+
+	for (std::thread & worker : pool->workers) {
+		worker.join();
+	}
+	pool->workers.clear();
+
+}
+
+int threadpool_getThreadCount(const ThreadPool * pool) {
+	return (int)pool->workers.size() + 1;
+}
+
+void threadpool_run(ThreadPool * pool, int task_count, const std::function<void(int)> & task) {
+
+	std::lock_guard<std::mutex> run_lock(pool->run_mutex);
+
+	//
+	//	Not worth waking anybody up for this
+	//
+	if (pool->workers.empty() || task_count <= 1) {
+		for (int i = 0; i < task_count; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->task = &task;
+		pool->task_count = task_count;
+		pool->next_task = 0;
+		pool->pending_workers = (int)pool->workers.size();
+		pool->generation++;
+	}
+	pool->work_available.notify_all();
+
+	runPendingTasks(pool);
+
+	std::unique_lock<std::mutex> lock(pool->mutex);
+	pool->work_finished.wait(lock, [&]() {
+		return pool->pending_workers == 0;
+	});
+
+	pool->task = nullptr;
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+//	Fixed pool of worker threads used to run the same task over
+//	a range of indices in parallel (our tiles of the frame). The
+//	thread that asks for the work also takes tasks, so a pool with
+//	no workers just runs everything on the calling thread.
+//
+struct ThreadPool {
+
+	std::vector<std::thread> workers;
+
+	//
+	//	Protects the job description and the counters below
+	//
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::condition_variable work_finished;
+
+	//
+	//	Only one caller can have a job running at a time
+	//
+	std::mutex run_mutex;
+
+	//
+	//	The job currently running
+	//
+	const std::function<void(int)> * task = nullptr;
+	int task_count = 0;
+	std::atomic<int> next_task{ 0 };
+
+	//
+	//	Workers that have not finished the current job yet
+	//
+	int pending_workers = 0;
+
+	//
+	//	Incremented every time a new job is published
+	//
+	unsigned int generation = 0;
+
+	bool stopping = false;
+
+};
+
+
+//
+//	Starts the worker threads. With 0 or less we use as many
+//	threads as the machine has (counting the calling thread).
+//
+void threadpool_init(ThreadPool * pool, int thread_count);
+
+
+//
+//	Stops and joins all the worker threads
+//
+void threadpool_destroy(ThreadPool * pool);
+
+
+//
+//	Amount of threads that take tasks, counting the calling one
+//
+int threadpool_getThreadCount(const ThreadPool * pool);
+
+
+//
+//	Runs task(i) for every i in [0, task_count) and returns
+//	when all of them are done
+//
+void threadpool_run(ThreadPool * pool, int task_count, const std::function<void(int)> & task);
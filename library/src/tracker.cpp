@@ -0,0 +1,228 @@
+#include "tracker.h"
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in tracker.h, the math is commented here.
+//
+
+void tracker_reset(BallTracker * tracker) {
+
+	tracker->state = TrackerState::zeros();
+	tracker->covariance = TrackerCovariance::eye();
+	tracker->timestamp = 0.0;
+	tracker->measurement_count = 0;
+	tracker->coasting_frames = 0;
+	tracker->initialized = false;
+
+}
+
+void tracker_start(
+	BallTracker * tracker,
+	const BbTrackingParameters * parameters,
+	cv::Point2f position,
+	float radius,
+	double timestamp) {
+
+	tracker_reset(tracker);
+
+	tracker->state(TRACKER_X) = position.x;
+	tracker->state(TRACKER_Y) = position.y;
+	tracker->state(TRACKER_RADIUS) = radius;
+
+	float position_variance = parameters->position_noise * parameters->position_noise;
+	float velocity_variance = TRACKER_INITIAL_VELOCITY_STD * TRACKER_INITIAL_VELOCITY_STD;
+	float acceleration_variance = TRACKER_INITIAL_ACCELERATION_STD * TRACKER_INITIAL_ACCELERATION_STD;
+
+	tracker->covariance = TrackerCovariance::zeros();
+	tracker->covariance(TRACKER_X, TRACKER_X) = position_variance;
+	tracker->covariance(TRACKER_Y, TRACKER_Y) = position_variance;
+	tracker->covariance(TRACKER_VX, TRACKER_VX) = velocity_variance;
+	tracker->covariance(TRACKER_VY, TRACKER_VY) = velocity_variance;
+	tracker->covariance(TRACKER_AX, TRACKER_AX) = acceleration_variance;
+	tracker->covariance(TRACKER_AY, TRACKER_AY) = acceleration_variance;
+	tracker->covariance(TRACKER_RADIUS, TRACKER_RADIUS) = parameters->radius_noise * parameters->radius_noise;
+
+	tracker->timestamp = timestamp;
+	tracker->measurement_count = 1;
+	tracker->initialized = true;
+
+}
+
+void tracker_predict(BallTracker * tracker, const BbTrackingParameters * parameters, double timestamp) {
+
+	float dt = (float)(timestamp - tracker->timestamp);
+
+	//
+	//	Frames coming out of order or with the same timestamp leave the
+	//	state as it is. Going back less than the readout time is fine, it
+	//	is a row of the same frame read before the one we predicted to.
+	//
+	if (!tracker->initialized || dt == 0.0f || (dt < 0.0f && -dt >= parameters->readout_time)) {
+		return;
+	}
+
+	//
+	//	Backwards the uncertainty grows as much as forwards
+	//
+	float noise_dt = std::abs(dt);
+	float dt2 = dt * dt;
+	float noise_dt2 = noise_dt * noise_dt;
+	float noise_dt3 = noise_dt2 * noise_dt;
+	float noise_dt4 = noise_dt3 * noise_dt;
+	float noise_dt5 = noise_dt4 * noise_dt;
+
+	//
+	//	Constant acceleration motion, the radius stays the same
+	//
+	TrackerCovariance transition = TrackerCovariance::eye();
+	for (int axis = 0; axis < 2; axis++) {
+		transition(TRACKER_X + axis, TRACKER_VX + axis) = dt;
+		transition(TRACKER_X + axis, TRACKER_AX + axis) = 0.5f * dt2;
+		transition(TRACKER_VX + axis, TRACKER_AX + axis) = dt;
+	}
+
+	//
+	//	The noise comes from a random jerk (white noise in the change
+	//	of acceleration) integrated over dt and a random walk on the radius
+	//
+	float jerk_variance = parameters->process_noise * parameters->process_noise;
+
+	TrackerCovariance process_noise = TrackerCovariance::zeros();
+	for (int axis = 0; axis < 2; axis++) {
+		int p = TRACKER_X + axis;
+		int v = TRACKER_VX + axis;
+		int a = TRACKER_AX + axis;
+		process_noise(p, p) = jerk_variance * noise_dt5 / 20.0f;
+		process_noise(p, v) = process_noise(v, p) = jerk_variance * noise_dt4 / 8.0f;
+		process_noise(p, a) = process_noise(a, p) = jerk_variance * noise_dt3 / 6.0f;
+		process_noise(v, v) = jerk_variance * noise_dt3 / 3.0f;
+		process_noise(v, a) = process_noise(a, v) = jerk_variance * noise_dt2 / 2.0f;
+		process_noise(a, a) = jerk_variance * noise_dt;
+	}
+	process_noise(TRACKER_RADIUS, TRACKER_RADIUS) =
+		parameters->radius_process_noise * parameters->radius_process_noise * noise_dt;
+
+	tracker->state = transition * tracker->state;
+	tracker->covariance = transition * tracker->covariance * transition.t() + process_noise;
+	tracker->timestamp = timestamp;
+
+}
+
+void tracker_correct(
+	BallTracker * tracker,
+	const BbTrackingParameters * parameters,
+	cv::Point2f position,
+	float radius) {
+
+	if (!tracker->initialized) {
+		return;
+	}
+
+	//
+	//	We measure the position and the radius directly
+	//
+	cv::Matx<float, 3, TRACKER_STATE_SIZE> measurement_matrix = cv::Matx<float, 3, TRACKER_STATE_SIZE>::zeros();
+	measurement_matrix(0, TRACKER_X) = 1.0f;
+	measurement_matrix(1, TRACKER_Y) = 1.0f;
+	measurement_matrix(2, TRACKER_RADIUS) = 1.0f;
+
+	cv::Matx31f measurement(position.x, position.y, radius);
+
+	float position_variance = parameters->position_noise * parameters->position_noise;
+	cv::Matx33f measurement_noise = cv::Matx33f::diag(cv::Matx31f(
+		position_variance,
+		position_variance,
+		parameters->radius_noise * parameters->radius_noise));
+
+	cv::Matx31f innovation = measurement - measurement_matrix * tracker->state;
+	cv::Matx33f innovation_covariance =
+		measurement_matrix * tracker->covariance * measurement_matrix.t() + measurement_noise;
+
+	cv::Matx<float, TRACKER_STATE_SIZE, 3> gain =
+		tracker->covariance * measurement_matrix.t() * innovation_covariance.inv(cv::DECOMP_CHOLESKY);
+
+	tracker->state += gain * innovation;
+	tracker->covariance = (TrackerCovariance::eye() - gain * measurement_matrix) * tracker->covariance;
+
+	//
+	//	Keeping the covariance symmetric, float errors pile up otherwise
+	//
+	tracker->covariance = (tracker->covariance + tracker->covariance.t()) * 0.5f;
+
+	tracker->measurement_count++;
+	tracker->coasting_frames = 0;
+
+}
+
+void tracker_correctVelocity(
+	BallTracker * tracker,
+	cv::Point2f velocity,
+	float deviation) {
+
+	if (!tracker->initialized) {
+		return;
+	}
+
+	//
+	//	Same as the position correction, done right after it, only
+	//	with the velocity as the measurement
+	//
+	cv::Matx<float, 2, TRACKER_STATE_SIZE> measurement_matrix = cv::Matx<float, 2, TRACKER_STATE_SIZE>::zeros();
+	measurement_matrix(0, TRACKER_VX) = 1.0f;
+	measurement_matrix(1, TRACKER_VY) = 1.0f;
+
+	cv::Matx21f measurement(velocity.x, velocity.y);
+
+	float variance = deviation * deviation;
+	cv::Matx22f measurement_noise(variance, 0.0f, 0.0f, variance);
+
+	cv::Matx21f innovation = measurement - measurement_matrix * tracker->state;
+	cv::Matx22f innovation_covariance =
+		measurement_matrix * tracker->covariance * measurement_matrix.t() + measurement_noise;
+
+	cv::Matx<float, TRACKER_STATE_SIZE, 2> gain =
+		tracker->covariance * measurement_matrix.t() * innovation_covariance.inv(cv::DECOMP_CHOLESKY);
+
+	tracker->state += gain * innovation;
+	tracker->covariance = (TrackerCovariance::eye() - gain * measurement_matrix) * tracker->covariance;
+	tracker->covariance = (tracker->covariance + tracker->covariance.t()) * 0.5f;
+
+}
+
+float tracker_getSquaredDistance(
+	const BallTracker * tracker,
+	const BbTrackingParameters * parameters,
+	cv::Point2f position) {
+
+	//
+	//	Same innovation covariance as the correction, for the position only
+	//
+	float position_variance = parameters->position_noise * parameters->position_noise;
+	cv::Matx22f innovation_covariance(
+		tracker->covariance(TRACKER_X, TRACKER_X) + position_variance,
+		tracker->covariance(TRACKER_X, TRACKER_Y),
+		tracker->covariance(TRACKER_Y, TRACKER_X),
+		tracker->covariance(TRACKER_Y, TRACKER_Y) + position_variance);
+
+	cv::Matx21f innovation(position.x - tracker->state(TRACKER_X), position.y - tracker->state(TRACKER_Y));
+
+	return (innovation.t() * innovation_covariance.inv(cv::DECOMP_CHOLESKY) * innovation)(0);
+
+}
+
+cv::Point2f tracker_getPosition(const BallTracker * tracker) {
+	return cv::Point2f(tracker->state(TRACKER_X), tracker->state(TRACKER_Y));
+}
+
+cv::Point2f tracker_getVelocity(const BallTracker * tracker) {
+	return cv::Point2f(tracker->state(TRACKER_VX), tracker->state(TRACKER_VY));
+}
+
+cv::Point2f tracker_getAcceleration(const BallTracker * tracker) {
+	return cv::Point2f(tracker->state(TRACKER_AX), tracker->state(TRACKER_AY));
+}
+
+float tracker_getRadius(const BallTracker * tracker) {
+	return tracker->state(TRACKER_RADIUS);
+}
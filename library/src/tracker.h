@@ -0,0 +1,128 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include "bopbol.h"
+
+//
+//	Layout of the state of the tracker: position, velocity and
+//	acceleration in pixels (and seconds) plus the radius of the ball
+//
+#define TRACKER_STATE_SIZE 7
+
+enum TrackerStateIndex {
+	TRACKER_X = 0,
+	TRACKER_Y,
+	TRACKER_VX,
+	TRACKER_VY,
+	TRACKER_AX,
+	TRACKER_AY,
+	TRACKER_RADIUS
+};
+
+//
+//	Uncertainty of the velocity and acceleration of a ball we
+//	just started tracking, we know nothing about them yet
+//
+#define TRACKER_INITIAL_VELOCITY_STD 2000.0f
+#define TRACKER_INITIAL_ACCELERATION_STD 5000.0f
+
+typedef cv::Matx<float, TRACKER_STATE_SIZE, 1> TrackerState;
+typedef cv::Matx<float, TRACKER_STATE_SIZE, TRACKER_STATE_SIZE> TrackerCovariance;
+
+//
+//	Constant acceleration Kalman filter following one ball
+//
+struct BallTracker {
+
+	TrackerState state;
+	TrackerCovariance covariance;
+
+	//
+	//	Capture time (in seconds) the state refers to
+	//
+	double timestamp;
+
+	//
+	//	Amount of measurements used since we started tracking
+	//	and frames in a row we have only predicted the ball
+	//
+	int measurement_count;
+	int coasting_frames;
+
+	bool initialized;
+
+};
+
+
+//
+//	Leaves the tracker without any ball
+//
+void tracker_reset(BallTracker * tracker);
+
+
+//
+//	Starts tracking a ball seen for the first time
+//
+void tracker_start(
+	BallTracker * tracker,
+	const BbTrackingParameters * parameters,
+	cv::Point2f position,
+	float radius,
+	double timestamp);
+
+
+//
+//	Moves the state forward to the given capture time, or back if it is
+//	less than the readout time earlier (another row of the same frame)
+//
+void tracker_predict(BallTracker * tracker, const BbTrackingParameters * parameters, double timestamp);
+
+
+//
+//	Corrects the predicted state with the position and radius of
+//	the ball measured in the frame
+//
+void tracker_correct(
+	BallTracker * tracker,
+	const BbTrackingParameters * parameters,
+	cv::Point2f position,
+	float radius);
+
+
+//
+//	Corrects the state with a velocity measured in the frame (from the
+//	motion blur), with the given standard deviation in pixels per second
+//
+void tracker_correctVelocity(
+	BallTracker * tracker,
+	cv::Point2f velocity,
+	float deviation);
+
+
+//
+//	Squared Mahalanobis distance between a measured position and the one
+//	the tracker expects, using the uncertainty of both
+//
+float tracker_getSquaredDistance(
+	const BallTracker * tracker,
+	const BbTrackingParameters * parameters,
+	cv::Point2f position);
+
+
+//
+//	Capture time of a row of a frame from a rolling shutter camera that
+//	reads it from top to bottom in the readout time, being the timestamp
+//	of the frame the capture time of its middle row
+//
+inline double tracker_getRowTimestamp(double frame_timestamp, float row, int frame_rows, float readout_time) {
+	return frame_timestamp + readout_time * ((double)row / frame_rows - 0.5);
+}
+
+
+//
+//	Accessors for the filtered state
+//
+cv::Point2f tracker_getPosition(const BallTracker * tracker);
+cv::Point2f tracker_getVelocity(const BallTracker * tracker);
+cv::Point2f tracker_getAcceleration(const BallTracker * tracker);
+float tracker_getRadius(const BallTracker * tracker);
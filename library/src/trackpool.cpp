@@ -0,0 +1,302 @@
+#include "trackpool.h"
+#include <algorithm>
+#include <limits>
+
+//
+//	Comments explaining the types and functions are
+//	in trackpool.h, the details are commented here.
+//
+
+//
+//	A possible pairing of a track with a candidate blob
+//
+struct TrackPairing {
+	float distance;
+	int slot;
+	int candidate;
+};
+
+void trackpool_init(TrackPool * pool) {
+
+	for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+		trackpool_removeTrack(pool, slot);
+	}
+
+	pool->next_track_id = 1;
+
+}
+
+int trackpool_createTrack(TrackPool * pool) {
+
+	for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+		if (!pool->active[slot]) {
+
+			trackpool_removeTrack(pool, slot);
+
+			pool->active[slot] = true;
+			pool->track_id[slot] = pool->next_track_id++;
+
+			return slot;
+		}
+	}
+
+	return -1;
+}
+
+void trackpool_removeTrack(TrackPool * pool, int slot) {
+
+	pool->active[slot] = false;
+	pool->track_id[slot] = 0;
+
+	tracker_reset(&pool->tracker[slot]);
+	ringbuffer_init(&pool->history[slot]);
+
+	pool->samples_since_impact[slot] = 0;
+	pool->impact_predicted[slot] = false;
+	pool->predicted_impact_id[slot] = 0;
+	pool->predicted_impact_time[slot] = 0.0;
+	pool->predicted_impact_position[slot] = cv::Point2f(0.0f, 0.0f);
+	pool->assignment[slot] = -1;
+	pool->occluded_bounce[slot] = false;
+
+	pool->collision_phase[slot] = COLLISION_PHASE_IDLE;
+	pool->phase_frames[slot] = 0;
+	pool->approach_sign[slot] = 0;
+	pool->last_impact_time[slot] = -std::numeric_limits<double>::infinity();
+
+	pool->shadow_distance[slot] = -1.0f;
+	pool->previous_shadow_distance[slot] = -1.0f;
+	pool->previous_shadow_time[slot] = 0.0;
+	pool->shadow_converging_frames[slot] = 0;
+
+	pool->stereo_parallax[slot] = -1.0f;
+	for (int i = 0; i < 2; i++) {
+		pool->previous_stereo_parallax[slot][i] = -1.0f;
+		pool->previous_stereo_time[slot][i] = 0.0;
+	}
+
+}
+
+void trackpool_predict(
+	TrackPool * pool,
+	const BbTrackingParameters * parameters,
+	double timestamp,
+	int frame_rows) {
+
+	for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+		if (!pool->active[slot]) {
+			continue;
+		}
+
+		BallTracker * tracker = &pool->tracker[slot];
+
+		pool->previous_position[slot] = tracker_getPosition(tracker);
+		pool->previous_velocity[slot] = tracker_getVelocity(tracker);
+		pool->previous_radius[slot] = tracker_getRadius(tracker);
+		pool->previous_timestamp[slot] = tracker->timestamp;
+
+		//
+		//	The row where we expect the ball is read a bit before or after
+		//	the middle one, and we move straight there from the last state
+		//	so the gating compares the blobs with where the ball was when its
+		//	row was captured. A copy at the middle of the frame tells the row.
+		//
+		double row_timestamp = timestamp;
+		if (parameters->readout_time > 0.0f && tracker->initialized) {
+			BallTracker middle = *tracker;
+			tracker_predict(&middle, parameters, timestamp);
+			row_timestamp = tracker_getRowTimestamp(
+				timestamp, tracker_getPosition(&middle).y, frame_rows, parameters->readout_time);
+		}
+
+		tracker_predict(tracker, parameters, row_timestamp);
+	}
+
+}
+
+int trackpool_selectCandidates(
+	const std::vector<Blob> & blobs,
+	float radius_threshold,
+	float min_fill_ratio,
+	int candidates[TRACKPOOL_MAX_CANDIDATES]) {
+
+	int candidate_count = 0;
+
+	for (int i = 0; i < (int)blobs.size(); i++) {
+
+		if (blobs[i].radius <= radius_threshold || blobs[i].fill_ratio < min_fill_ratio) {
+			continue;
+		}
+
+		//
+		//	Insertion into the array sorted by area, the
+		//	smallest one falls off the end when it is full
+		//
+		int position = std::min(candidate_count, TRACKPOOL_MAX_CANDIDATES - 1);
+		if (candidate_count == TRACKPOOL_MAX_CANDIDATES &&
+			blobs[candidates[position]].stats.area >= blobs[i].stats.area) {
+			continue;
+		}
+
+		while (position > 0 && blobs[candidates[position - 1]].stats.area < blobs[i].stats.area) {
+			candidates[position] = candidates[position - 1];
+			position--;
+		}
+		candidates[position] = i;
+
+		candidate_count = std::min(candidate_count + 1, TRACKPOOL_MAX_CANDIDATES);
+	}
+
+	return candidate_count;
+}
+
+void trackpool_assign(
+	TrackPool * pool,
+	const BbTrackingParameters * parameters,
+	const std::vector<Blob> & blobs,
+	const int * candidates,
+	int candidate_count,
+	bool * candidate_used) {
+
+	//
+	//	Every pairing inside the gate, in a fixed array so we
+	//	don't allocate anything
+	//
+	TrackPairing pairings[TRACKPOOL_CAPACITY * TRACKPOOL_MAX_CANDIDATES];
+	int pairing_count = 0;
+
+	float squared_gate = parameters->association_gate * parameters->association_gate;
+
+	for (int slot = 0; slot < TRACKPOOL_CAPACITY; slot++) {
+
+		pool->assignment[slot] = -1;
+		pool->occluded_bounce[slot] = false;
+
+		if (!pool->active[slot] || !pool->tracker[slot].initialized) {
+			continue;
+		}
+
+		for (int c = 0; c < candidate_count; c++) {
+
+			float distance = tracker_getSquaredDistance(
+				&pool->tracker[slot], parameters, blobs[candidates[c]].centroid);
+
+			if (distance <= squared_gate) {
+				pairings[pairing_count].distance = distance;
+				pairings[pairing_count].slot = slot;
+				pairings[pairing_count].candidate = c;
+				pairing_count++;
+			}
+		}
+	}
+
+	for (int c = 0; c < candidate_count; c++) {
+		candidate_used[c] = false;
+	}
+
+	//
+	//	Greedy global nearest neighbour, with a handful of balls that are
+	//	usually far apart it gives the same answer as the optimal assignment
+	//
+	std::sort(pairings, pairings + pairing_count, [](const TrackPairing & a, const TrackPairing & b) {
+		return a.distance < b.distance;
+	});
+
+	for (int i = 0; i < pairing_count; i++) {
+
+		const TrackPairing & pairing = pairings[i];
+
+		if (pool->assignment[pairing.slot] >= 0 || candidate_used[pairing.candidate]) {
+			continue;
+		}
+
+		pool->assignment[pairing.slot] = candidates[pairing.candidate];
+		candidate_used[pairing.candidate] = true;
+	}
+
+}
+
+bool trackpool_updateCollisionPhase(
+	TrackPool * pool,
+	int slot,
+	const BbTrackingParameters * parameters,
+	int motion,
+	bool collision,
+	double timestamp) {
+
+	CollisionPhase & phase = pool->collision_phase[slot];
+	int & frames = pool->phase_frames[slot];
+
+	int hysteresis = std::max(1, parameters->direction_hysteresis_frames);
+	bool rested = (timestamp - pool->last_impact_time[slot] >= parameters->min_impact_interval);
+
+	switch (phase) {
+
+	case COLLISION_PHASE_IDLE:
+
+		//
+		//	A few frames in a row going towards the wall
+		//	before we believe the ball is approaching
+		//
+		frames = (motion > 0 ? frames + 1 : 0);
+		if (frames >= hysteresis) {
+			phase = COLLISION_PHASE_APPROACHING;
+			frames = 0;
+		}
+		return false;
+
+	case COLLISION_PHASE_APPROACHING:
+
+		if (collision && rested) {
+			phase = COLLISION_PHASE_IMPACT;
+			frames = 0;
+			pool->last_impact_time[slot] = timestamp;
+			return true;
+		}
+		return false;
+
+	case COLLISION_PHASE_IMPACT:
+
+		//
+		//	Whatever the detector says, this bounce is already reported
+		//	until the ball has been going away for a few frames
+		//
+		frames = (motion < 0 ? frames + 1 : 0);
+		if (frames >= hysteresis) {
+			phase = COLLISION_PHASE_RECEDING;
+			frames = 0;
+		}
+		return false;
+
+	case COLLISION_PHASE_RECEDING:
+
+		//
+		//	It can go back to the wall (after the minimum time between
+		//	impacts) or stop, when it gets caught or rolls on the floor
+		//
+		if (motion > 0) {
+			frames = (frames > 0 ? frames + 1 : 1);
+		}
+		else if (motion == 0) {
+			frames = (frames < 0 ? frames - 1 : -1);
+		}
+		else {
+			frames = 0;
+		}
+
+		if (frames >= hysteresis && rested) {
+			phase = COLLISION_PHASE_APPROACHING;
+			frames = 0;
+		}
+		else if (-frames >= hysteresis) {
+			phase = COLLISION_PHASE_IDLE;
+			frames = 0;
+		}
+		return false;
+
+	}
+
+	return false;
+}
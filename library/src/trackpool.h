@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "bopbol.h"
+#include "pipeline.h"
+#include "tracker.h"
+#include "types.h"
+
+//
+//	Amount of balls we can follow at the same time
+//
+#define TRACKPOOL_CAPACITY 8
+
+//
+//	Maximum amount of blobs (the biggest ones) of every
+//	frame we consider as balls
+//
+#define TRACKPOOL_MAX_CANDIDATES 16
+
+//
+//	Amount of past detections of every ball we keep around,
+//	it has to be a power of two
+//
+#define BALL_HISTORY_LENGTH 128
+
+typedef RingBuffer<BALL_HISTORY_LENGTH> BallHistory;
+
+//
+//	Where every ball is in its way to the wall and back, impacts
+//	are only reported when going from approaching to impact
+//
+enum CollisionPhase {
+	COLLISION_PHASE_IDLE = 0,
+	COLLISION_PHASE_APPROACHING,
+	COLLISION_PHASE_IMPACT,
+	COLLISION_PHASE_RECEDING
+};
+
+//
+//	Every ball we are following, stored as a structure of arrays indexed
+//	by the slot of the track. Slots are reused when balls get lost so
+//	nothing is allocated while processing the frames.
+//
+struct TrackPool {
+
+	//
+	//	Which slots have a ball and the id we give to it,
+	//	ids are never reused so the host can tell balls apart
+	//
+	bool active[TRACKPOOL_CAPACITY];
+	uint32_t track_id[TRACKPOOL_CAPACITY];
+
+	//
+	//	Motion model and past detections of every ball
+	//
+	BallTracker tracker[TRACKPOOL_CAPACITY];
+	BallHistory history[TRACKPOOL_CAPACITY];
+
+	//
+	//	Amount of the newest elements of the history that
+	//	came after the last impact of the ball
+	//
+	unsigned int samples_since_impact[TRACKPOOL_CAPACITY];
+
+	//
+	//	Whether we sent a predicted impact still waiting for its
+	//	confirmation, and its id, time and position in the frame
+	//
+	bool impact_predicted[TRACKPOOL_CAPACITY];
+	uint32_t predicted_impact_id[TRACKPOOL_CAPACITY];
+	double predicted_impact_time[TRACKPOOL_CAPACITY];
+	cv::Point2f predicted_impact_position[TRACKPOOL_CAPACITY];
+
+	//
+	//	Collision state machine of every ball: its phase, the frames in a
+	//	row we have seen the motion that moves it to the next phase (positive
+	//	towards the wall, negative standing still while receding), the side of
+	//	the wall along its axis from the calibration (1 or -1, 0 if unknown)
+	//	and when it last hit it
+	//
+	CollisionPhase collision_phase[TRACKPOOL_CAPACITY];
+	int phase_frames[TRACKPOOL_CAPACITY];
+	int approach_sign[TRACKPOOL_CAPACITY];
+	double last_impact_time[TRACKPOOL_CAPACITY];
+
+	//
+	//	Distance from every ball to its shadow in this frame (-1 if we
+	//	don't see it) and the last time we saw it, with the frames in a
+	//	row the shadow got closer to the ball
+	//
+	float shadow_distance[TRACKPOOL_CAPACITY];
+	float previous_shadow_distance[TRACKPOOL_CAPACITY];
+	double previous_shadow_time[TRACKPOOL_CAPACITY];
+	int shadow_converging_frames[TRACKPOOL_CAPACITY];
+
+	//
+	//	With two cameras, how much they disagree about where every ball is
+	//	in the area in this frame (-1 if the second one doesn't see it) and
+	//	in the last two frames they both saw it, newest first
+	//
+	float stereo_parallax[TRACKPOOL_CAPACITY];
+	float previous_stereo_parallax[TRACKPOOL_CAPACITY][2];
+	double previous_stereo_time[TRACKPOOL_CAPACITY][2];
+
+	//
+	//	The filtered state of the previous frame, the collision
+	//	detection compares the new measurement against it
+	//
+	cv::Point2f previous_position[TRACKPOOL_CAPACITY];
+	cv::Point2f previous_velocity[TRACKPOOL_CAPACITY];
+	float previous_radius[TRACKPOOL_CAPACITY];
+	double previous_timestamp[TRACKPOOL_CAPACITY];
+
+	//
+	//	Blob of the current frame assigned to every track, -1 if none
+	//
+	int assignment[TRACKPOOL_CAPACITY];
+
+	//
+	//	Set when the assigned blob is not where the ball was going but where
+	//	it would be after bouncing while we couldn't see it, with the impact
+	//	we inferred from the trajectories on both sides of the gap
+	//
+	bool occluded_bounce[TRACKPOOL_CAPACITY];
+	double occluded_impact_time[TRACKPOOL_CAPACITY];
+	cv::Point2f occluded_impact_position[TRACKPOOL_CAPACITY];
+	cv::Point2f occluded_impact_direction[TRACKPOOL_CAPACITY];
+
+	uint32_t next_track_id;
+
+};
+
+
+//
+//	Inits the pool without any track
+//
+void trackpool_init(TrackPool * pool);
+
+
+//
+//	Takes a free slot for a new ball and returns it, or -1 if the pool is full
+//
+int trackpool_createTrack(TrackPool * pool);
+
+
+//
+//	Frees the slot of a lost ball
+//
+void trackpool_removeTrack(TrackPool * pool, int slot);
+
+
+//
+//	Keeps the current state of every track as the previous one and moves
+//	them forward to the given capture time, or with a rolling shutter to
+//	the capture time of the row where we expect them in the frame
+//
+void trackpool_predict(
+	TrackPool * pool,
+	const BbTrackingParameters * parameters,
+	double timestamp,
+	int frame_rows);
+
+
+//
+//	Fills the candidates array with the indices of the biggest blobs (up to
+//	TRACKPOOL_MAX_CANDIDATES) with a radius over the threshold and round
+//	enough (filling at least that fraction of their circle), biggest first.
+//	Returns the amount of candidates.
+//
+int trackpool_selectCandidates(
+	const std::vector<Blob> & blobs,
+	float radius_threshold,
+	float min_fill_ratio,
+	int candidates[TRACKPOOL_MAX_CANDIDATES]);
+
+
+//
+//	Assigns the candidate blobs to the predicted tracks, closest pairs first
+//	as long as they are inside the gate (in standard deviations). Fills the
+//	assignment of every track and marks the candidates used.
+//
+void trackpool_assign(
+	TrackPool * pool,
+	const BbTrackingParameters * parameters,
+	const std::vector<Blob> & blobs,
+	const int * candidates,
+	int candidate_count,
+	bool * candidate_used);
+
+
+//
+//	Moves the collision state machine of a track with what we saw in this
+//	frame: the motion of the ball (1 towards the wall, -1 away from it, 0 if
+//	we can't tell) and whether the collision detector fired. Returns true
+//	if it is a new impact that has to be reported.
+//
+bool trackpool_updateCollisionPhase(
+	TrackPool * pool,
+	int slot,
+	const BbTrackingParameters * parameters,
+	int motion,
+	bool collision,
+	double timestamp);
@@ -0,0 +1,389 @@
+#include "trajectory.h"
+#include <algorithm>
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in trajectory.h, the math is commented here.
+//
+
+bool trajectory_fitSegment(
+	const RingBufferSpan * spans,
+	int span_count,
+	int order,
+	double reference_time,
+	TrajectorySegment * segment) {
+
+	//
+	//	Least squares with the normal equations. First the sums of the
+	//	powers of the time and of the coordinates, the loops only read
+	//	contiguous arrays.
+	//
+	double time_sums[2 * TRAJECTORY_MAX_ORDER + 1] = { 0 };
+	double x_sums[TRAJECTORY_MAX_ORDER + 1] = { 0 };
+	double y_sums[TRAJECTORY_MAX_ORDER + 1] = { 0 };
+	int sample_count = 0;
+
+	for (int s = 0; s < span_count; s++) {
+
+		const RingBufferSpan & span = spans[s];
+
+		for (unsigned int i = 0; i < span.count; i++) {
+
+			double t = span.timestamp[i] - reference_time;
+			double t2 = t * t;
+
+			time_sums[0] += 1.0;
+			time_sums[1] += t;
+			time_sums[2] += t2;
+			time_sums[3] += t2 * t;
+			time_sums[4] += t2 * t2;
+
+			x_sums[0] += span.x[i];
+			x_sums[1] += t * span.x[i];
+			x_sums[2] += t2 * span.x[i];
+
+			y_sums[0] += span.y[i];
+			y_sums[1] += t * span.y[i];
+			y_sums[2] += t2 * span.y[i];
+		}
+
+		sample_count += span.count;
+	}
+
+	if (sample_count == 0) {
+		return false;
+	}
+
+	//
+	//	We need at least order + 1 samples
+	//
+	order = std::max(0, std::min(std::min(order, TRAJECTORY_MAX_ORDER), sample_count - 1));
+
+	//
+	//	The unused orders get an identity row so we always solve
+	//	the same 3x3 system and their coefficients come out as 0
+	//
+	cv::Matx33d normal_matrix = cv::Matx33d::eye();
+	cv::Matx31d x_vector, y_vector;
+
+	for (int row = 0; row <= order; row++) {
+		for (int column = 0; column <= order; column++) {
+			normal_matrix(row, column) = time_sums[row + column];
+		}
+		x_vector(row) = x_sums[row];
+		y_vector(row) = y_sums[row];
+	}
+
+	cv::Matx31d x_coefficients = normal_matrix.solve(x_vector, cv::DECOMP_LU);
+	cv::Matx31d y_coefficients = normal_matrix.solve(y_vector, cv::DECOMP_LU);
+
+	segment->reference_time = reference_time;
+	segment->order = order;
+	segment->sample_count = sample_count;
+	for (int i = 0; i <= TRAJECTORY_MAX_ORDER; i++) {
+		segment->coefficients_x[i] = x_coefficients(i);
+		segment->coefficients_y[i] = y_coefficients(i);
+	}
+
+	//
+	//	And how well the curve follows the samples
+	//
+	double squared_error = 0.0;
+	for (int s = 0; s < span_count; s++) {
+		const RingBufferSpan & span = spans[s];
+		for (unsigned int i = 0; i < span.count; i++) {
+			cv::Point2f fitted = trajectory_evaluate(segment, span.timestamp[i]);
+			double dx = fitted.x - span.x[i];
+			double dy = fitted.y - span.y[i];
+			squared_error += dx * dx + dy * dy;
+		}
+	}
+	segment->residual = (float)std::sqrt(squared_error / sample_count);
+
+	return true;
+}
+
+void trajectory_reflectSegment(
+	const TrajectorySegment * incoming,
+	cv::Point2f normal,
+	float restitution,
+	cv::Point2f position,
+	double timestamp,
+	double reference_time,
+	TrajectorySegment * segment) {
+
+	//
+	//	v_out = v_in - (1 + e) (v_in . n) n
+	//
+	cv::Point2f velocity = trajectory_evaluateVelocity(incoming, timestamp);
+	float normal_speed = velocity.dot(normal);
+	velocity -= (1.0f + restitution) * normal_speed * normal;
+
+	//
+	//	The line goes through the sample, written with the shared
+	//	reference time: p(t) = position + v * (t - timestamp)
+	//
+	double offset = reference_time - timestamp;
+
+	segment->reference_time = reference_time;
+	segment->order = 1;
+	segment->sample_count = 1;
+	segment->residual = 0.0f;
+
+	segment->coefficients_x[0] = position.x + velocity.x * offset;
+	segment->coefficients_x[1] = velocity.x;
+	segment->coefficients_y[0] = position.y + velocity.y * offset;
+	segment->coefficients_y[1] = velocity.y;
+	for (int i = 2; i <= TRAJECTORY_MAX_ORDER; i++) {
+		segment->coefficients_x[i] = 0.0;
+		segment->coefficients_y[i] = 0.0;
+	}
+
+}
+
+cv::Point2f trajectory_evaluate(const TrajectorySegment * segment, double timestamp) {
+
+	double t = timestamp - segment->reference_time;
+
+	double x = segment->coefficients_x[0] + t * (segment->coefficients_x[1] + t * segment->coefficients_x[2]);
+	double y = segment->coefficients_y[0] + t * (segment->coefficients_y[1] + t * segment->coefficients_y[2]);
+
+	return cv::Point2f((float)x, (float)y);
+}
+
+cv::Point2f trajectory_evaluateVelocity(const TrajectorySegment * segment, double timestamp) {
+
+	double t = timestamp - segment->reference_time;
+
+	double vx = segment->coefficients_x[1] + 2.0 * t * segment->coefficients_x[2];
+	double vy = segment->coefficients_y[1] + 2.0 * t * segment->coefficients_y[2];
+
+	return cv::Point2f((float)vx, (float)vy);
+}
+
+bool trajectory_intersect(
+	const TrajectorySegment * incoming,
+	const TrajectorySegment * outgoing,
+	cv::Point2f direction,
+	double begin_time,
+	double end_time,
+	double * impact_time,
+	cv::Point2f * impact_position) {
+
+	double reference_time = incoming->reference_time;
+
+	//
+	//	Difference of the distances along the direction as a
+	//	polynomial a + b t + c t^2 that we want to be 0
+	//
+	double coefficients[TRAJECTORY_MAX_ORDER + 1];
+	for (int i = 0; i <= TRAJECTORY_MAX_ORDER; i++) {
+		coefficients[i] =
+			direction.x * (incoming->coefficients_x[i] - outgoing->coefficients_x[i]) +
+			direction.y * (incoming->coefficients_y[i] - outgoing->coefficients_y[i]);
+	}
+
+	double a = coefficients[0];
+	double b = coefficients[1];
+	double c = coefficients[2];
+
+	double begin = begin_time - reference_time;
+	double end = end_time - reference_time;
+
+	double roots[2];
+	int root_count = 0;
+
+	if (std::abs(c) < 1e-9) {
+		if (std::abs(b) > 1e-9) {
+			roots[root_count++] = -a / b;
+		}
+	}
+	else {
+		double discriminant = b * b - 4.0 * a * c;
+		if (discriminant >= 0.0) {
+			double root = std::sqrt(discriminant);
+			roots[root_count++] = (-b - root) / (2.0 * c);
+			roots[root_count++] = (-b + root) / (2.0 * c);
+		}
+	}
+
+	//
+	//	If both roots are in the interval the first one is the impact
+	//
+	double t = 0.0;
+	bool found = false;
+	for (int i = 0; i < root_count; i++) {
+		if (roots[i] >= begin && roots[i] <= end && (!found || roots[i] < t)) {
+			t = roots[i];
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	*impact_time = reference_time + t;
+
+	//
+	//	Along the direction both are the same, for the rest
+	//	we take the middle point between the two curves
+	//
+	*impact_position = (trajectory_evaluate(incoming, *impact_time) + trajectory_evaluate(outgoing, *impact_time)) * 0.5f;
+
+	return true;
+}
+
+bool trajectory_fitDepth(
+	const RingBufferSpan * spans,
+	int span_count,
+	double reference_time,
+	DepthSegment * segment) {
+
+	//
+	//	Plain linear regression of 1 / r against the time
+	//
+	double sum_t = 0.0, sum_tt = 0.0, sum_d = 0.0, sum_td = 0.0;
+	int sample_count = 0;
+
+	for (int s = 0; s < span_count; s++) {
+
+		const RingBufferSpan & span = spans[s];
+
+		for (unsigned int i = 0; i < span.count; i++) {
+
+			double t = span.timestamp[i] - reference_time;
+			double d = 1.0 / std::max(span.radius[i], 1.0f);
+
+			sum_t += t;
+			sum_tt += t * t;
+			sum_d += d;
+			sum_td += t * d;
+		}
+
+		sample_count += span.count;
+	}
+
+	if (sample_count < 2) {
+		return false;
+	}
+
+	double determinant = sample_count * sum_tt - sum_t * sum_t;
+	if (determinant <= 1e-12) {
+		return false;
+	}
+
+	segment->reference_time = reference_time;
+	segment->coefficients[1] = (sample_count * sum_td - sum_t * sum_d) / determinant;
+	segment->coefficients[0] = (sum_d - segment->coefficients[1] * sum_t) / sample_count;
+	segment->sample_count = sample_count;
+
+	double squared_error = 0.0;
+	for (int s = 0; s < span_count; s++) {
+		const RingBufferSpan & span = spans[s];
+		for (unsigned int i = 0; i < span.count; i++) {
+			double error = trajectory_evaluateDepth(segment, span.timestamp[i]) - 1.0 / std::max(span.radius[i], 1.0f);
+			squared_error += error * error;
+		}
+	}
+	segment->residual = (float)std::sqrt(squared_error / sample_count);
+
+	return true;
+}
+
+double trajectory_evaluateDepth(const DepthSegment * segment, double timestamp) {
+	return segment->coefficients[0] + segment->coefficients[1] * (timestamp - segment->reference_time);
+}
+
+bool trajectory_findDepthCrossing(
+	const DepthSegment * segment,
+	float radius,
+	double begin_time,
+	double * crossing_time) {
+
+	if (radius <= 0.0f || segment->coefficients[1] == 0.0) {
+		return false;
+	}
+
+	double target = 1.0 / radius;
+	double current = trajectory_evaluateDepth(segment, begin_time);
+
+	//
+	//	It has to be moving towards the target depth
+	//
+	if ((target - current) * segment->coefficients[1] < 0.0) {
+		return false;
+	}
+
+	*crossing_time = begin_time + (target - current) / segment->coefficients[1];
+	return true;
+}
+
+DepthTrend trajectory_checkDepthTrend(
+	const DepthSegment * incoming,
+	float radius,
+	float radius_noise,
+	double timestamp) {
+
+	//
+	//	Only a ball going away from the camera (towards the wall) can bounce
+	//
+	if (incoming->sample_count < 3 || incoming->coefficients[1] <= 0.0 || radius <= 0.0f) {
+		return DEPTH_TREND_UNKNOWN;
+	}
+
+	//
+	//	The noise of the radius in inverse radius units is
+	//	sigma_r / r^2, plus how far the samples were from the line
+	//
+	double measured = 1.0 / radius;
+	double measurement_deviation = radius_noise * measured * measured;
+	double deviation = std::sqrt(
+		(double)incoming->residual * incoming->residual +
+		measurement_deviation * measurement_deviation);
+
+	double predicted = trajectory_evaluateDepth(incoming, timestamp);
+	double last = trajectory_evaluateDepth(incoming, incoming->reference_time);
+
+	if (predicted - measured > 3.0 * deviation) {
+		return DEPTH_TREND_REVERSED;
+	}
+
+	//
+	//	Between both it could be either, so we don't say
+	//
+	if (predicted - last > deviation &&
+		std::abs(predicted - measured) <= TRAJECTORY_DEPTH_FOLLOW_DEVIATIONS * deviation) {
+		return DEPTH_TREND_CONTINUING;
+	}
+
+	return DEPTH_TREND_UNKNOWN;
+}
+
+bool trajectory_intersectDepth(
+	const DepthSegment * incoming,
+	float restitution,
+	float radius,
+	double timestamp,
+	double begin_time,
+	double end_time,
+	double * impact_time) {
+
+	double slope = incoming->coefficients[1];
+
+	if (slope <= 0.0 || radius <= 0.0f) {
+		return false;
+	}
+
+	//
+	//	c0 + c1 * (t - t0) = 1 / r - e * c1 * (t - tc), solved for t
+	//
+	double reference_offset = timestamp - incoming->reference_time;
+	double t = (1.0 / radius - incoming->coefficients[0] + restitution * slope * reference_offset) /
+		(slope * (1.0 + restitution));
+
+	*impact_time = incoming->reference_time + t;
+
+	return *impact_time >= begin_time && *impact_time <= end_time;
+}
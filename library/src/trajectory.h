@@ -0,0 +1,184 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include "types.h"
+
+//
+//	Highest order of the polynomials we fit to the trajectories
+//
+#define TRAJECTORY_MAX_ORDER 2
+
+//
+//	Standard deviations a radius can be off the depth segment
+//	and still follow it, the ball keeps going to the wall
+//
+#define TRAJECTORY_DEPTH_FOLLOW_DEVIATIONS 2.0
+
+//
+//	A piece of the trajectory of the ball between two impacts modelled as
+//	polynomials of the time: p(t) = c0 + c1 * (t - t0) + c2 * (t - t0)^2
+//
+struct TrajectorySegment {
+
+	//
+	//	The t0 of the polynomials, in seconds of the capture clock
+	//
+	double reference_time;
+
+	double coefficients_x[TRAJECTORY_MAX_ORDER + 1];
+	double coefficients_y[TRAJECTORY_MAX_ORDER + 1];
+
+	//
+	//	Order actually used, it can be lower than the one asked
+	//	for if there were not enough samples
+	//
+	int order;
+
+	//
+	//	Samples used for the fit and the root mean square
+	//	distance of those samples to the fitted curve in pixels
+	//
+	int sample_count;
+	float residual;
+
+};
+
+//
+//	The inverse of the apparent radius of the ball modelled as a line of the
+//	time: 1 / r(t) = c0 + c1 * (t - t0). The apparent radius is inversely
+//	proportional to the distance to the camera so this is the depth of the
+//	ball up to scale, and it changes linearly if the ball speed along the
+//	view direction doesn't change.
+//
+struct DepthSegment {
+
+	double reference_time;
+	double coefficients[2];
+
+	//
+	//	Samples used for the fit and the root mean square
+	//	distance of those samples to the fitted line
+	//
+	int sample_count;
+	float residual;
+
+};
+
+
+//
+//	What a new radius measurement says about the depth trend of the ball
+//
+enum DepthTrend {
+	DEPTH_TREND_UNKNOWN = 0,
+	DEPTH_TREND_CONTINUING,
+	DEPTH_TREND_REVERSED
+};
+
+
+//
+//	Fits a segment with the given order to the samples in the spans (in
+//	chronological order), using the given reference time for the polynomials.
+//	Returns false if there are no samples.
+//
+bool trajectory_fitSegment(
+	const RingBufferSpan * spans,
+	int span_count,
+	int order,
+	double reference_time,
+	TrajectorySegment * segment);
+
+
+//
+//	Builds the linear segment leaving a wall with the given normal direction
+//	through a single sample, reflecting the velocity the incoming segment has
+//	at that time and scaling its normal component by the restitution
+//
+void trajectory_reflectSegment(
+	const TrajectorySegment * incoming,
+	cv::Point2f normal,
+	float restitution,
+	cv::Point2f position,
+	double timestamp,
+	double reference_time,
+	TrajectorySegment * segment);
+
+
+//
+//	Position and velocity of the segment at a given capture time
+//
+cv::Point2f trajectory_evaluate(const TrajectorySegment * segment, double timestamp);
+cv::Point2f trajectory_evaluateVelocity(const TrajectorySegment * segment, double timestamp);
+
+
+//
+//	Finds the time in [begin_time, end_time] at which both segments are
+//	at the same distance along the given direction, that is, where the ball
+//	turned around. Both segments must share the reference time. Returns false
+//	if they don't meet inside the interval.
+//
+bool trajectory_intersect(
+	const TrajectorySegment * incoming,
+	const TrajectorySegment * outgoing,
+	cv::Point2f direction,
+	double begin_time,
+	double end_time,
+	double * impact_time,
+	cv::Point2f * impact_position);
+
+
+//
+//	Fits a depth segment to the radius of the samples in the spans. Returns
+//	false if there are less than two samples or they all share the time.
+//
+bool trajectory_fitDepth(
+	const RingBufferSpan * spans,
+	int span_count,
+	double reference_time,
+	DepthSegment * segment);
+
+
+//
+//	Inverse radius of the depth segment at a given capture time
+//
+double trajectory_evaluateDepth(const DepthSegment * segment, double timestamp);
+
+
+//
+//	Finds the time after begin_time at which the ball reaches the depth where
+//	its radius is the given one. Returns false if it is moving away from it.
+//
+bool trajectory_findDepthCrossing(
+	const DepthSegment * segment,
+	float radius,
+	double begin_time,
+	double * crossing_time);
+
+
+//
+//	Compares a new radius measurement with the depth segment of the ball
+//	moving away from the camera. If the ball is clearly less deep than the
+//	segment expects it bounced (reversed), if it follows the segment (closer
+//	than TRAJECTORY_DEPTH_FOLLOW_DEVIATIONS to it) and the segment moves more
+//	than the noise it is still going (continuing).
+//
+DepthTrend trajectory_checkDepthTrend(
+	const DepthSegment * incoming,
+	float radius,
+	float radius_noise,
+	double timestamp);
+
+
+//
+//	Finds the time in [begin_time, end_time] at which the ball turned around
+//	in depth, with the outgoing depth going through the given measurement at
+//	the incoming speed scaled by the restitution. Returns false if it is not
+//	inside the interval.
+//
+bool trajectory_intersectDepth(
+	const DepthSegment * incoming,
+	float restitution,
+	float radius,
+	double timestamp,
+	double begin_time,
+	double end_time,
+	double * impact_time);
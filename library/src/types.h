@@ -1,51 +1,190 @@
 #pragma once
 
-#include <cstring>
-#include <iostream>
+#include <cstdint>
 #include <opencv2/opencv.hpp>
 
-#define DEQUE_LENGTH 100
+//
+//	Fixed capacity ring buffer storing the history of a ball. The capacity
+//	has to be a power of two so wrapping around is just a mask, and the data
+//	is stored as a structure of arrays so the fitting code can run over
+//	contiguous x, y, radius and timestamp values.
+//
+template <unsigned int CAPACITY>
+struct RingBuffer {
 
-struct Deque {
+	static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+		"The capacity of a RingBuffer must be a power of two");
+
+	static const unsigned int MASK = CAPACITY - 1;
 
 	//
 	//	The data itself
 	//
-	cv::Point2f data[DEQUE_LENGTH];
+	float x[CAPACITY];
+	float y[CAPACITY];
+	float radius[CAPACITY];
+	double timestamp[CAPACITY];
+	uint32_t frame_id[CAPACITY];
 
 	//
-	//	The current position of the tail of the queue.
-	//	By definition, the head of the queue is the previous
-	//	element modulus the length
+	//	Amount of elements ever inserted, the position of the next
+	//	insertion is this value masked. Being unsigned it can wrap
+	//	around safely.
 	//
-	unsigned int tail_position;
+	uint32_t head;
 
 	//
 	//	Keeps track of the amount of elements currently
-	//	inserted in the deque
+	//	stored in the buffer, it saturates at CAPACITY
 	//
-	unsigned int size;
+	uint32_t size;
+
+};
 
+//
+//	One element of the ring buffer
+//
+struct RingBufferSample {
+	float x;
+	float y;
+	float radius;
+	double timestamp;
+	uint32_t frame_id;
 };
 
+//
+//	A contiguous range of the ring buffer in chronological order
+//
+struct RingBufferSpan {
+	const float * x;
+	const float * y;
+	const float * radius;
+	const double * timestamp;
+	const uint32_t * frame_id;
+	unsigned int count;
+};
+
+
+//
+//	Inits the ring buffer without any element
+//
+template <unsigned int CAPACITY>
+inline void ringbuffer_init(RingBuffer<CAPACITY> * buffer) {
+
+	buffer->head = 0;
+	buffer->size = 0;
+
+}
+
 
 //
-//	Inits the deque and puts all the values to 0
+//	Inserts a new element, overwriting the oldest one when full
 //
-void deque_init(Deque * deque);
+template <unsigned int CAPACITY>
+inline void ringbuffer_insert(
+	RingBuffer<CAPACITY> * buffer,
+	float x, float y, float radius,
+	double timestamp, uint32_t frame_id) {
+
+	unsigned int index = buffer->head & RingBuffer<CAPACITY>::MASK;
+
+	buffer->x[index] = x;
+	buffer->y[index] = y;
+	buffer->radius[index] = radius;
+	buffer->timestamp[index] = timestamp;
+	buffer->frame_id[index] = frame_id;
+
+	buffer->head++;
+	buffer->size = (buffer->size < CAPACITY ? buffer->size + 1 : CAPACITY);
+
+}
 
 
 //
-//	Inserts an element in a given position
+//	Returns the position in the arrays of the element with the given
+//	age, 0 being the newest one. The age must be smaller than the size.
 //
-void deque_insertElement(Deque * deque, cv::Point2f element);
+template <unsigned int CAPACITY>
+inline unsigned int ringbuffer_getIndex(const RingBuffer<CAPACITY> * buffer, unsigned int age) {
+	return (buffer->head - 1u - age) & RingBuffer<CAPACITY>::MASK;
+}
 
 
 //
-//	Returns the element located at a given position
+//	Returns the element with the given age, 0 being the newest one
 //
-cv::Point2f deque_getElementAt(Deque * deque, unsigned int position);
+template <unsigned int CAPACITY>
+inline RingBufferSample ringbuffer_getElementAt(const RingBuffer<CAPACITY> * buffer, unsigned int age) {
 
+	unsigned int index = ringbuffer_getIndex(buffer, age);
 
+	RingBufferSample sample;
+	sample.x = buffer->x[index];
+	sample.y = buffer->y[index];
+	sample.radius = buffer->radius[index];
+	sample.timestamp = buffer->timestamp[index];
+	sample.frame_id = buffer->frame_id[index];
 
+	return sample;
+}
 
+
+//
+//	Returns the position of the element with the given age
+//
+template <unsigned int CAPACITY>
+inline cv::Point2f ringbuffer_getPosition(const RingBuffer<CAPACITY> * buffer, unsigned int age) {
+
+	unsigned int index = ringbuffer_getIndex(buffer, age);
+
+	return cv::Point2f(buffer->x[index], buffer->y[index]);
+}
+
+
+//
+//	Splits the elements with ages in [first_age, first_age + count) in at
+//	most two contiguous spans in chronological order (oldest first). Returns
+//	the amount of spans filled, the count is clamped to the stored elements.
+//
+template <unsigned int CAPACITY>
+inline int ringbuffer_getSpans(
+	const RingBuffer<CAPACITY> * buffer,
+	unsigned int first_age,
+	unsigned int count,
+	RingBufferSpan spans[2]) {
+
+	if (first_age >= buffer->size) {
+		return 0;
+	}
+
+	if (count > buffer->size - first_age) {
+		count = buffer->size - first_age;
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	unsigned int oldest = ringbuffer_getIndex(buffer, first_age + count - 1);
+	unsigned int first_count = (oldest + count <= CAPACITY ? count : CAPACITY - oldest);
+
+	spans[0].x = buffer->x + oldest;
+	spans[0].y = buffer->y + oldest;
+	spans[0].radius = buffer->radius + oldest;
+	spans[0].timestamp = buffer->timestamp + oldest;
+	spans[0].frame_id = buffer->frame_id + oldest;
+	spans[0].count = first_count;
+
+	if (first_count == count) {
+		return 1;
+	}
+
+	spans[1].x = buffer->x;
+	spans[1].y = buffer->y;
+	spans[1].radius = buffer->radius;
+	spans[1].timestamp = buffer->timestamp;
+	spans[1].frame_id = buffer->frame_id;
+	spans[1].count = count - first_count;
+
+	return 2;
+}
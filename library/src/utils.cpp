@@ -98,4 +98,17 @@ void utilscv_sortSquarePoints(std::vector<cv::Point2f> * data) {
 
 	return;
 
-}
\ No newline at end of file
+}
+
+void utilscv_inRangeHSV(const cv::Mat & hsv, const cv::Scalar & low, const cv::Scalar & high, cv::Mat & mask, cv::Mat & scratch) {
+
+	if (low[0] <= high[0]) {
+		cv::inRange(hsv, low, high, mask);
+		return;
+	}
+
+	cv::inRange(hsv, low, cv::Scalar(179, high[1], high[2]), mask);
+	cv::inRange(hsv, cv::Scalar(0, low[1], low[2]), high, scratch);
+	cv::bitwise_or(mask, scratch, mask);
+
+}
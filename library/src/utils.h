@@ -34,3 +34,11 @@ void utilscv_resizeCloseTo(cv::Mat * image, int width);
 //
 void utilscv_sortSquarePoints(std::vector<cv::Point2f> * data);
 
+
+//
+//	inRange for HSV images where the hue goes around: if the lower hue
+//	is bigger than the upper one the range is the hues from the lower one
+//	to 179 and from 0 to the upper one (reds). The scratch image is only
+//	used then, to keep the second half.
+//
+void utilscv_inRangeHSV(const cv::Mat & hsv, const cv::Scalar & low, const cv::Scalar & high, cv::Mat & mask, cv::Mat & scratch);
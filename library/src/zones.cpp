@@ -0,0 +1,149 @@
+#include "zones.h"
+#include <algorithm>
+#include <cmath>
+
+//
+//	Comments explaining the types and functions are
+//	in zones.h, the details are commented here.
+//
+
+//
+//	Cell of the grid along one side, the points out of the
+//	area fall in the cells of its border
+//
+static int getCell(double coordinate) {
+	double cell = std::floor(coordinate * ZONES_GRID_SIZE);
+	return (int)std::min(std::max(cell, 0.0), (double)(ZONES_GRID_SIZE - 1));
+}
+
+//
+//	Bounding box of a zone in normalized coordinates
+//
+static void getBounds(const BbHitZone & zone, double * min_x, double * min_y, double * max_x, double * max_y) {
+
+	if (zone.shape == BB_ZONE_CIRCLE) {
+		*min_x = zone.center.x - zone.radius;
+		*min_y = zone.center.y - zone.radius;
+		*max_x = zone.center.x + zone.radius;
+		*max_y = zone.center.y + zone.radius;
+		return;
+	}
+
+	*min_x = *min_y = INFINITY;
+	*max_x = *max_y = -INFINITY;
+
+	for (uint32_t i = 0; i < zone.vertex_count; i++) {
+		*min_x = std::min(*min_x, zone.vertices[i].x);
+		*min_y = std::min(*min_y, zone.vertices[i].y);
+		*max_x = std::max(*max_x, zone.vertices[i].x);
+		*max_y = std::max(*max_y, zone.vertices[i].y);
+	}
+}
+
+//
+//	Exact test of a point against a zone, the polygons with the
+//	even-odd rule so they can be concave
+//
+static bool containsPoint(const BbHitZone & zone, double x, double y) {
+
+	if (zone.shape == BB_ZONE_CIRCLE) {
+		double dx = x - zone.center.x;
+		double dy = y - zone.center.y;
+		return dx * dx + dy * dy <= zone.radius * zone.radius;
+	}
+
+	bool inside = false;
+
+	for (uint32_t i = 0, j = zone.vertex_count - 1; i < zone.vertex_count; j = i++) {
+
+		const BbPoint2d & a = zone.vertices[i];
+		const BbPoint2d & b = zone.vertices[j];
+
+		if ((a.y > y) != (b.y > y) &&
+			x < a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y)) {
+			inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+void zones_build(ZoneIndex * index, const BbHitZone * zones, uint32_t zone_count) {
+
+	index->zones.clear();
+
+	//
+	//	Polygons need at least a triangle, anything else can't be hit
+	//
+	for (uint32_t i = 0; i < zone_count; i++) {
+
+		BbHitZone zone = zones[i];
+		zone.vertex_count = std::min(zone.vertex_count, (uint32_t)BB_MAX_ZONE_VERTICES);
+
+		if ((zone.shape == BB_ZONE_CIRCLE && zone.radius > 0.0) ||
+			(zone.shape == BB_ZONE_POLYGON && zone.vertex_count >= 3)) {
+			index->zones.push_back(zone);
+		}
+	}
+
+	//
+	//	Two passes over the cells every zone covers, first counting
+	//	and then filling, so the cells end up contiguous in order
+	//
+	const int cell_count = ZONES_GRID_SIZE * ZONES_GRID_SIZE;
+	index->cell_start.assign(cell_count + 1, 0);
+
+	for (int pass = 0; pass < 2; pass++) {
+
+		std::vector<uint32_t> fill;
+		if (pass == 1) {
+			for (int cell = 0; cell < cell_count; cell++) {
+				index->cell_start[cell + 1] += index->cell_start[cell];
+			}
+			index->cell_zones.resize(index->cell_start[cell_count]);
+			fill.assign(index->cell_start.begin(), index->cell_start.end() - 1);
+		}
+
+		for (uint32_t z = 0; z < (uint32_t)index->zones.size(); z++) {
+
+			double min_x, min_y, max_x, max_y;
+			getBounds(index->zones[z], &min_x, &min_y, &max_x, &max_y);
+
+			for (int cell_y = getCell(min_y); cell_y <= getCell(max_y); cell_y++) {
+				for (int cell_x = getCell(min_x); cell_x <= getCell(max_x); cell_x++) {
+
+					int cell = cell_y * ZONES_GRID_SIZE + cell_x;
+
+					if (pass == 0) {
+						index->cell_start[cell + 1]++;
+					}
+					else {
+						index->cell_zones[fill[cell]++] = z;
+					}
+				}
+			}
+		}
+	}
+
+}
+
+uint32_t zones_find(const ZoneIndex * index, uint32_t area_id, float x, float y, uint32_t * zone_ids, uint32_t max_ids) {
+
+	if (index->zones.empty() || !std::isfinite(x) || !std::isfinite(y)) {
+		return 0;
+	}
+
+	int cell = getCell(y) * ZONES_GRID_SIZE + getCell(x);
+	uint32_t found = 0;
+
+	for (uint32_t i = index->cell_start[cell]; i < index->cell_start[cell + 1] && found < max_ids; i++) {
+
+		const BbHitZone & zone = index->zones[index->cell_zones[i]];
+
+		if (zone.area_id == area_id && containsPoint(zone, x, y)) {
+			zone_ids[found++] = zone.zone_id;
+		}
+	}
+
+	return found;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "bopbol.h"
+
+//
+//	Cells of the grid along every side of the area, zones are
+//	only tested against the impacts falling in their cells
+//
+#define ZONES_GRID_SIZE 16
+
+//
+//	Uniform grid over the normalized area with the zones overlapping every
+//	cell, the zones of all the projection areas together. Once built it is
+//	never modified, so the processing thread can read it while the host
+//	builds the next one.
+//
+struct ZoneIndex {
+
+	std::vector<BbHitZone> zones;
+
+	//
+	//	Indices of the zones of every cell, one cell after the other (row
+	//	by row) with the first index of every cell in cell_start, which has
+	//	an extra element at the end with the total
+	//
+	std::vector<uint32_t> cell_start;
+	std::vector<uint32_t> cell_zones;
+
+};
+
+
+//
+//	Builds the index for the given zones, replacing what it had
+//
+void zones_build(ZoneIndex * index, const BbHitZone * zones, uint32_t zone_count);
+
+
+//
+//	Finds the zones of the given projection area containing the point in
+//	normalized coordinates, in the order they were given, and writes up to
+//	max_ids of their ids. Returns the amount of ids written.
+//
+uint32_t zones_find(const ZoneIndex * index, uint32_t area_id, float x, float y, uint32_t * zone_ids, uint32_t max_ids);